@@ -1,23 +1,28 @@
 #include <stdlib.h>
 #include <stdio.h>
-#include <time.h>
 #include <string.h>
-#include <SDL2/SDL.h>
+#include <assert.h>
 
 #include "chip8.h"
 
-const unsigned int KEY_COUNT = 16;
-const unsigned int MEMORY_SIZE = 4096;
-const unsigned int REGISTER_COUNT = 16;
-const unsigned int STACK_LEVELS = 16;
-const unsigned int VIDEO_HEIGHT = 32;
-const unsigned int VIDEO_WIDTH = 64;
+static const unsigned int MEMORY_SIZE = 4096;
+static const unsigned int STACK_LEVELS = 16;
+static const unsigned int VIDEO_HEIGHT = 32;
+static const unsigned int VIDEO_WIDTH = 64;
 
-const unsigned int FONTSET_SIZE = 80;
-const unsigned int FONTSET_START_ADDRESS = 0x50;
-const unsigned int START_ADDRESS = 0x200;
+static const unsigned int FONTSET_SIZE = 80;
+static const unsigned int FONTSET_START_ADDRESS = 0x50;
+static const unsigned int START_ADDRESS = 0x200;
 
-uint8_t fontset[FONTSET_SIZE] = {
+static const unsigned int DEFAULT_CYCLES_PER_FRAME = 10;
+static const uint32_t DEFAULT_SEED = 0;
+
+// 1.7609 MHz VIP clock / 8 clocks per machine cycle / 60 Hz = 3668.5
+static const int VIP_FRAME_CYCLES = 3668;
+// Cycles stolen per frame by CDP1861 display DMA (128 lines x 8 bytes) and its interrupt routine
+static const int VIP_DISPLAY_CYCLES = 1070;
+
+static const uint8_t fontset[] = {
 	0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
 	0x20, 0x60, 0x20, 0x20, 0x70, // 1
 	0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
@@ -36,37 +41,92 @@ uint8_t fontset[FONTSET_SIZE] = {
 	0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 };
 
+#ifdef CHIP8_FUZZ
+uint8_t fuzzCoverage[FUZZ_MAP_SIZE];
+uint16_t fuzzPrevPc;
+#endif
+
+#ifdef CHIP8_PROFILE
+struct memoryProfile memoryProfile;
+
+static void profileWrite(struct chip8* chip, uint16_t address) {
+    address &= 0xFFF;
+    ++memoryProfile.writes[address];
+
+    // Writing over bytes that were already executed
+    if(memoryProfile.fetches[address] == 0) {
+        return;
+    }
+
+    ++memoryProfile.smcWrites[address];
+    ++memoryProfile.smcCount;
+
+    // Keep each distinct (writer, address) pair once
+    for (uint32_t i = 0; i < memoryProfile.smcEventCount; ++i) {
+        struct smcEvent* event = &memoryProfile.smcEvents[i];
+        if(event->pc == chip->pc - 2 && event->address == address) {
+            return;
+        }
+    }
+
+    if(memoryProfile.smcEventCount < PROFILE_MAX_SMC_EVENTS) {
+        struct smcEvent* event = &memoryProfile.smcEvents[memoryProfile.smcEventCount++];
+        event->pc = chip->pc - 2;
+        event->opcode = chip->opcode;
+        event->address = address;
+    }
+}
+#endif
+
+// Branch-free so legal opcodes only pay for the compare; the instance stays
+// memory-safe either way because every checked access is also masked.
+static inline void check_fault(struct chip8* chip, bool condition, enum chip8Fault fault) {
+    chip->faults |= condition << fault;
+    chip->events |= condition << CHIP8_FAULT;
+}
+
+// Cold path, once execution has stopped on a fault
+static void record_fault(struct chip8* chip, uint16_t pc) {
+    chip->faultPc = pc;
+    chip->faultOpcode = chip->opcode;
+}
+
 //OPCODES
 
 //00E0 - CLS -- Clear the display.
-void OP_00E0(struct chip8* chip) {
+static void OP_00E0(struct chip8* chip) {
     memset(chip->video, 0, sizeof(chip->video));
+    chip->events |= CHIP8_EVENT(CHIP8_DISPLAY);
 }
 
 //00EE - RET -- Return from a subroutine.
-void OP_00EE(struct chip8* chip) {
+static void OP_00EE(struct chip8* chip) {
+    check_fault(chip, chip->sp == 0, CHIP8_FAULT_STACK_UNDERFLOW);
+
     --chip->sp;
-    chip->pc = chip->stack[chip->sp];
+    chip->pc = chip->stack[chip->sp & 0xFu];
 }
 
 //1nnn - JP to addr nnn -- Jump to location nnn.
-void OP_1nnn(struct chip8* chip) {
+static void OP_1nnn(struct chip8* chip) {
     uint16_t address = chip->opcode & 0x0FFF;
 
     chip->pc = address;
 }
 
 //2nnn - Call addr nnn -- Call subroutine at nnn.
-void OP_2nnn(struct chip8* chip) {
+static void OP_2nnn(struct chip8* chip) {
     uint16_t address = chip->opcode & 0x0FFF;
 
-    chip->stack[chip->sp] = chip->pc;
+    check_fault(chip, chip->sp >= STACK_LEVELS, CHIP8_FAULT_STACK_OVERFLOW);
+
+    chip->stack[chip->sp & 0xFu] = chip->pc;
     ++chip->sp;
     chip->pc = address;
 }
 
 //3xkk - SE Vx, byte -- Skip next instruction if Vx = kk.
-void OP_3xkk(struct chip8* chip) {
+static void OP_3xkk(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 	uint8_t byte = chip->opcode & 0x00FFu;
 
@@ -76,7 +136,7 @@ void OP_3xkk(struct chip8* chip) {
 }
 
 //4xkk - SNE Vx, byte -- Skip next instruction if Vx != kk.
-void OP_4xkk(struct chip8* chip) {
+static void OP_4xkk(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 	uint8_t byte = chip->opcode & 0x00FFu;
 
@@ -86,7 +146,7 @@ void OP_4xkk(struct chip8* chip) {
 }
 
 //5xy0 - SE Vx, Vy -- Skip next instruction if Vx = Vy.
-void OP_5xy0(struct chip8* chip) {
+static void OP_5xy0(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 	uint8_t Vy = (chip->opcode & 0x00F0u) >> 4u;
 
@@ -96,7 +156,7 @@ void OP_5xy0(struct chip8* chip) {
 }
 
 //6xkk - LD Vx, byte -- Set Vx = kk.
-void OP_6xkk(struct chip8* chip) {
+static void OP_6xkk(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 	uint8_t byte = chip->opcode & 0x00FFu;
 
@@ -104,7 +164,7 @@ void OP_6xkk(struct chip8* chip) {
 }
 
 //7xkk - ADD Vx, byte -- Set Vx = Vx + kk.
-void OP_7xkk(struct chip8* chip) {
+static void OP_7xkk(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 	uint8_t byte = chip->opcode & 0x00FFu;
 
@@ -112,7 +172,7 @@ void OP_7xkk(struct chip8* chip) {
 }
 
 //8xy0 - LD Vx, Vy -- Set Vx = Vy.
-void OP_8xy0(struct chip8* chip) {
+static void OP_8xy0(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 	uint8_t Vy = (chip->opcode & 0x00F0u) >> 4u;
 
@@ -120,7 +180,7 @@ void OP_8xy0(struct chip8* chip) {
 }
 
 //8xy1 - OR Vx, Vy -- Set Vx = Vx OR Vy.
-void OP_8xy1(struct chip8* chip) {
+static void OP_8xy1(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 	uint8_t Vy = (chip->opcode & 0x00F0u) >> 4u;
 
@@ -128,7 +188,7 @@ void OP_8xy1(struct chip8* chip) {
 }
 
 //8xy2 - AND Vx, Vy -- Set Vx = Vx AND Vy.
-void OP_8xy2(struct chip8* chip) {
+static void OP_8xy2(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 	uint8_t Vy = (chip->opcode & 0x00F0u) >> 4u;
 
@@ -136,7 +196,7 @@ void OP_8xy2(struct chip8* chip) {
 }
 
 //8xy3 - XOR Vx, Vy -- Set Vx = Vx XOR Vy.
-void OP_8xy3(struct chip8* chip) {
+static void OP_8xy3(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 	uint8_t Vy = (chip->opcode & 0x00F0u) >> 4u;
 
@@ -144,7 +204,7 @@ void OP_8xy3(struct chip8* chip) {
 }
 
 //8xy4 - ADD Vx, Vy -- Set Vx = Vx + Vy, set VF = carry.
-void OP_8xy4(struct chip8* chip) {
+static void OP_8xy4(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 	uint8_t Vy = (chip->opcode & 0x00F0u) >> 4u;
 
@@ -161,7 +221,7 @@ void OP_8xy4(struct chip8* chip) {
 }
 
 //8xy5 - SUB Vx, Vy -- Set Vx = Vx - Vy, set VF = NOT borrow.
-void OP_8xy5(struct chip8* chip) {
+static void OP_8xy5(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 	uint8_t Vy = (chip->opcode & 0x00F0u) >> 4u;
 
@@ -176,7 +236,7 @@ void OP_8xy5(struct chip8* chip) {
 }
 
 //8xy6 - SHR Vx -- Set Vx = Vx SHR 1.
-void OP_8xy6(struct chip8* chip) {
+static void OP_8xy6(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 
 	// Save LSB in VF
@@ -186,7 +246,7 @@ void OP_8xy6(struct chip8* chip) {
 }
 
 //8xy7 - SUBN Vx, Vy -- Set Vx = Vy - Vx, set VF = NOT borrow.
-void OP_8xy7(struct chip8* chip) {
+static void OP_8xy7(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 	uint8_t Vy = (chip->opcode & 0x00F0u) >> 4u;
 
@@ -201,7 +261,7 @@ void OP_8xy7(struct chip8* chip) {
 }
 
 //8xyE - SHL Vx {, Vy} -- Set Vx = Vx SHL 1.
-void OP_8xyE(struct chip8* chip) {
+static void OP_8xyE(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 
 	// Save MSB in VF
@@ -211,7 +271,7 @@ void OP_8xyE(struct chip8* chip) {
 }
 
 //9xy0 - SNE Vx, Vy -- Skip next instruction if Vx != Vy.
-void OP_9xy0(struct chip8* chip) {
+static void OP_9xy0(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 	uint8_t Vy = (chip->opcode & 0x00F0u) >> 4u;
 
@@ -221,29 +281,38 @@ void OP_9xy0(struct chip8* chip) {
 }
 
 //Annn - LD I, addr -- Set I = nnn.
-void OP_Annn(struct chip8* chip) {
+static void OP_Annn(struct chip8* chip) {
 	uint16_t address = chip->opcode & 0x0FFFu;
 
 	chip->index = address;
 }
 
 //Bnnn - JP V0, addr -- Jump to location nnn + V0.
-void OP_Bnnn(struct chip8* chip) {
+static void OP_Bnnn(struct chip8* chip) {
 	uint16_t address = chip->opcode & 0x0FFFu;
 
 	chip->pc = chip->registers[0] + address;
+
+	check_fault(chip, chip->pc > MEMORY_SIZE - 2, CHIP8_FAULT_MEMORY_RANGE);
 }
 
 //Cxkk - RND Vx, byte -- Set Vx = random byte AND kk.
-void OP_Cxkk(struct chip8* chip) {
+static void OP_Cxkk(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 	uint8_t byte = chip->opcode & 0x00FFu;
 
-	chip->registers[Vx] = rand() & byte;
+	// xorshift32, so every instance has its own reproducible sequence
+	uint32_t x = chip->rngState;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	chip->rngState = x;
+
+	chip->registers[Vx] = (x >> 24) & byte;
 }
 
 //Dxyn - DRW Vx, Vy, nibble -- Display n-byte sprite starting at memory location I at (Vx, Vy), set VF = collision.
-void OP_Dxyn(struct chip8* chip) {
+static void OP_Dxyn(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 	uint8_t Vy = (chip->opcode & 0x00F0u) >> 4u;
 	uint8_t height = chip->opcode & 0x000Fu;
@@ -252,13 +321,23 @@ void OP_Dxyn(struct chip8* chip) {
 	uint8_t xPos = chip->registers[Vx] % VIDEO_WIDTH;
 	uint8_t yPos = chip->registers[Vy] % VIDEO_HEIGHT;
 
+	// Clip at the screen edges
+	unsigned int rows = yPos + height > VIDEO_HEIGHT ? VIDEO_HEIGHT - yPos : height;
+	unsigned int cols = xPos + 8 > VIDEO_WIDTH ? VIDEO_WIDTH - xPos : 8;
+
 	chip->registers[0xF] = 0;
+	chip->events |= CHIP8_EVENT(CHIP8_DISPLAY);
+
+	check_fault(chip, chip->index + height > MEMORY_SIZE, CHIP8_FAULT_MEMORY_RANGE);
 
-	for (unsigned int row = 0; row < height; ++row)
+	for (unsigned int row = 0; row < rows; ++row)
 	{
-		uint8_t spriteByte = chip->memory[chip->index + row];
+		uint8_t spriteByte = chip->memory[(chip->index + row) & 0xFFFu];
+#ifdef CHIP8_PROFILE
+		++memoryProfile.spriteReads[(chip->index + row) & 0xFFF];
+#endif
 
-		for (unsigned int col = 0; col < 8; ++col)
+		for (unsigned int col = 0; col < cols; ++col)
 		{
 			uint8_t spritePixel = spriteByte & (0x80u >> col);
 			uint32_t* screenPixel = &(chip->video[(yPos + row) * VIDEO_WIDTH + (xPos + col)]);
@@ -280,10 +359,10 @@ void OP_Dxyn(struct chip8* chip) {
 }
 
 //Ex9E - SKP Vx -- Skip next instruction if key with the value of Vx is pressed.
-void OP_Ex9E(struct chip8* chip) {
+static void OP_Ex9E(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 
-	uint8_t key = chip->registers[Vx];
+	uint8_t key = chip->registers[Vx] & 0xFu;
 
 	if (chip->keypad[key]) {
 		chip->pc += 2;
@@ -291,10 +370,10 @@ void OP_Ex9E(struct chip8* chip) {
 }
 
 //ExA1 - SKNP Vx -- Skip next instruction if key with the value of Vx is not pressed.
-void OP_ExA1(struct chip8* chip) {
+static void OP_ExA1(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 
-	uint8_t key = chip->registers[Vx];
+	uint8_t key = chip->registers[Vx] & 0xFu;
 
 	if (!chip->keypad[key]) {
 		chip->pc += 2;
@@ -302,14 +381,14 @@ void OP_ExA1(struct chip8* chip) {
 }
 
 //Fx07 - LD Vx, DT -- Set Vx = delay timer value.
-void OP_Fx07(struct chip8* chip) {
+static void OP_Fx07(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 
 	chip->registers[Vx] = chip->delayTimer;
 }
 
 //Fx0A - LD Vx, K -- Wait for a key press, store the value of the key in Vx.
-void OP_Fx0A(struct chip8* chip) {
+static void OP_Fx0A(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 
 	if (chip->keypad[0]) {
@@ -362,32 +441,39 @@ void OP_Fx0A(struct chip8* chip) {
 	}
 	else {
 		chip->pc -= 2;
+		chip->events |= CHIP8_EVENT(CHIP8_KEY_WAIT);
 	}
 }
 
 //Fx15 - LD DT, Vx -- Set delay timer = Vx.
-void OP_Fx15(struct chip8* chip) {
+static void OP_Fx15(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 
 	chip->delayTimer = chip->registers[Vx];
 }
 
 //Fx18 - LD ST, Vx -- Set sound timer = Vx.
-void OP_Fx18(struct chip8* chip) {
+static void OP_Fx18(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 
+	uint8_t previous = chip->soundTimer;
+
 	chip->soundTimer = chip->registers[Vx];
+
+	if (!previous != !chip->soundTimer) {
+		chip->events |= CHIP8_EVENT(chip->soundTimer ? CHIP8_SOUND_ON : CHIP8_SOUND_OFF);
+	}
 }
 
 //Fx1E - ADD I, Vx -- Set I = I + Vx.
-void OP_Fx1E(struct chip8* chip) {
+static void OP_Fx1E(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 
 	chip->index += chip->registers[Vx];
 }
 
 //Fx29 - LD F, Vx -- Set I = location of sprite for digit Vx.
-void OP_Fx29(struct chip8* chip) {
+static void OP_Fx29(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 	uint8_t digit = chip->registers[Vx];
 
@@ -395,43 +481,66 @@ void OP_Fx29(struct chip8* chip) {
 }
 
 //Fx33 - LD B, Vx -- Store BCD representation of Vx in memory locations I, I+1, and I+2.
-void OP_Fx33(struct chip8* chip) {
+static void OP_Fx33(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 	uint8_t value = chip->registers[Vx];
 
+	check_fault(chip, chip->index + 3 > MEMORY_SIZE, CHIP8_FAULT_MEMORY_RANGE);
+
+#ifdef CHIP8_PROFILE
+	profileWrite(chip, chip->index);
+	profileWrite(chip, chip->index + 1);
+	profileWrite(chip, chip->index + 2);
+#endif
+
 	// Ones-place
-	chip->memory[chip->index + 2] = value % 10;
+	chip->memory[(chip->index + 2) & 0xFFFu] = value % 10;
 	value /= 10;
 
 	// Tens-place
-	chip->memory[chip->index + 1] = value % 10;
+	chip->memory[(chip->index + 1) & 0xFFFu] = value % 10;
 	value /= 10;
 
 	// Hundreds-place
-	chip->memory[chip->index] = value % 10;
+	chip->memory[chip->index & 0xFFFu] = value % 10;
 }
 
 //Fx55 - LD [I], Vx -- Store registers V0 through Vx in memory starting at location I.
-void OP_Fx55(struct chip8* chip) {
+static void OP_Fx55(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 
+	check_fault(chip, chip->index + Vx + 1 > MEMORY_SIZE, CHIP8_FAULT_MEMORY_RANGE);
+
 	for (uint8_t i = 0; i <= Vx; ++i)
 	{
-		chip->memory[chip->index + i] = chip->registers[i];
+		chip->memory[(chip->index + i) & 0xFFFu] = chip->registers[i];
+#ifdef CHIP8_PROFILE
+		profileWrite(chip, chip->index + i);
+#endif
 	}
 }
 
 //Fx65 - LD Vx, [I] -- Read registers V0 through Vx from memory starting at location I.
-void OP_Fx65(struct chip8* chip) {
+static void OP_Fx65(struct chip8* chip) {
 	uint8_t Vx = (chip->opcode & 0x0F00u) >> 8u;
 
+	check_fault(chip, chip->index + Vx + 1 > MEMORY_SIZE, CHIP8_FAULT_MEMORY_RANGE);
+
 	for (uint8_t i = 0; i <= Vx; ++i)
 	{
-		chip->registers[i] = chip->memory[chip->index + i];
+		chip->registers[i] = chip->memory[(chip->index + i) & 0xFFFu];
+#ifdef CHIP8_PROFILE
+		++memoryProfile.dataReads[(chip->index + i) & 0xFFF];
+#endif
 	}
 }
 
-void execute_opcode(struct chip8* chip) {
+static void unknown_opcode(struct chip8* chip) {
+    chip->faults |= 1u << CHIP8_FAULT_ILLEGAL_OPCODE;
+    chip->events |= CHIP8_EVENT(CHIP8_FAULT);
+}
+
+static void execute_opcode(struct chip8* chip) {
     switch(chip->opcode & 0xF000) {
         //1nnn
         case 0x1000:
@@ -521,8 +630,7 @@ void execute_opcode(struct chip8* chip) {
                     OP_8xyE(chip);
                     break;
                 default:
-                    printf("Error: Unknown opcode.\n OPCODE - %X\n", chip->opcode);
-                    exit(1);
+                    unknown_opcode(chip);
             }
             break;
         //00E_
@@ -537,8 +645,7 @@ void execute_opcode(struct chip8* chip) {
                     OP_00EE(chip);
                     break;
                 default:
-                    printf("Error: Unknown opcode.\n OPCODE - %X\n", chip->opcode);
-                    exit(1);
+                    unknown_opcode(chip);
             }
             break;
         //Ex__
@@ -553,8 +660,7 @@ void execute_opcode(struct chip8* chip) {
                     OP_Ex9E(chip);
                     break;
                 default:
-                    printf("Error: Unknown opcode.\n OPCODE - %X\n", chip->opcode);
-                    exit(1);
+                    unknown_opcode(chip);
             }
             break;
         //Fx__
@@ -597,282 +703,361 @@ void execute_opcode(struct chip8* chip) {
                     OP_Fx65(chip);
                     break;
                 default:
-                    printf("Error: Unknown opcode.\n OPCODE - %X\n", chip->opcode);
-                    exit(1);
+                    unknown_opcode(chip);
             }
             break;
         default:
-            printf("Error: Unknown opcode.\n OPCODE - %X\n", chip->opcode);
-            exit(1);
+            unknown_opcode(chip);
     }
 }
 
 // CHIP-8 methods
 
-struct chip8* init() {
-    struct chip8* chip = (struct chip8*)malloc(sizeof(struct chip8));
+struct chip8* chip8_init(void) {
+    struct chip8* chip = (struct chip8*)aligned_alloc(CACHE_LINE_SIZE, sizeof(struct chip8));
 
     if(chip == NULL) {
         printf("Error: Wasn't able to initiate process.\n");
-        exit(1);
+        return NULL;
     }
 
+    chip8_reset(chip);
+
+    return chip;
+}
+
+// Puts an instance back to power-on state; the ROM has to be loaded again
+void chip8_reset(struct chip8* chip) {
+    memset(chip, 0, sizeof(struct chip8));
+
     chip->pc = START_ADDRESS;
+    chip->cyclesPerFrame = DEFAULT_CYCLES_PER_FRAME;
+    chip->frameCycles = DEFAULT_CYCLES_PER_FRAME;
 
-    for (int i = 0; i < FONTSET_SIZE; ++i)
-	{
-		chip->memory[FONTSET_START_ADDRESS + i] = fontset[i];
-	}
+    memcpy(&chip->memory[FONTSET_START_ADDRESS], fontset, FONTSET_SIZE);
 
-    srand(time(NULL));
+    // Every reset is the same; hosts that want varying Cxkk results call chip8_seed()
+    chip8_seed(chip, DEFAULT_SEED);
+}
 
-    return chip;
+void chip8_destroy(struct chip8* chip) {
+    free(chip);
 }
 
-void load(struct chip8* chip, const char* file_path) {
+bool chip8_load(struct chip8* chip, const char* file_path) {
     FILE* rom = fopen(file_path, "rb");
     if (rom == NULL) {
         printf("Error: Failed to open ROM.\n");
-        exit(1);
+        return false;
     }
 
     fseek(rom, 0, SEEK_END);
     long rom_size = ftell(rom);
     rewind(rom);
 
-    char* rom_buffer = (char*) malloc(sizeof(char) * rom_size);
-    if (rom_buffer == NULL) {
-        printf("Error: Failed to allocate memory for ROM.\n");
-        exit(1);
+    if (rom_size < 0 || rom_size > MEMORY_SIZE - START_ADDRESS) {
+        printf("ROM too large to fit in memory.\n");
+        fclose(rom);
+        return false;
     }
 
-    size_t result = fread(rom_buffer, sizeof(char), (size_t)rom_size, rom);
-    if (result != rom_size) {
-        printf("Error: Failed to read ROM.\n");
-        exit(1);
-    }
+    size_t result = fread(&chip->memory[START_ADDRESS], sizeof(uint8_t), (size_t)rom_size, rom);
+    fclose(rom);
 
-    if ((4096-512) > rom_size){
-        for (int i = 0; i < rom_size; ++i) {
-            chip->memory[i + START_ADDRESS] = (uint8_t)rom_buffer[i];
-        }
-    }
-    else {
-        printf("ROM too large to fit in memory.\n");
-        exit(1);
+    if (result != (size_t)rom_size) {
+        printf("Error: Failed to read ROM.\n");
+        return false;
     }
 
-    fclose(rom);
-    free(rom_buffer);
+    return true;
 }
 
-void cycle(struct chip8* chip) {
-    chip->opcode = chip->memory[chip->pc] << 8 | chip->memory[chip->pc + 1];
+static inline void step(struct chip8* chip) {
+#ifdef CHIP8_FUZZ
+    // Edge coverage over (prev_pc, pc) pairs
+    ++fuzzCoverage[((fuzzPrevPc * 0x9E3Bu) ^ chip->pc) & (FUZZ_MAP_SIZE - 1)];
+    fuzzPrevPc = chip->pc;
+#endif
+
+#ifdef CHIP8_PROFILE
+    ++memoryProfile.fetches[chip->pc & 0xFFF];
+    ++memoryProfile.fetches[(chip->pc + 1) & 0xFFF];
+#endif
+
+    // Running off the end of memory, whichever instruction got the pc there
+    check_fault(chip, chip->pc > MEMORY_SIZE - 2, CHIP8_FAULT_MEMORY_RANGE);
+    chip->opcode = chip->memory[chip->pc & 0xFFFu] << 8 | chip->memory[(chip->pc + 1) & 0xFFFu];
 
     chip->pc += 2;
 
-    execute_opcode(chip);   
+    execute_opcode(chip);
+}
 
+static inline void tickTimers(struct chip8* chip) {
     if(chip->delayTimer > 0) {
         --chip->delayTimer;
     }
 
     if(chip->soundTimer > 0) {
-        if(chip->soundTimer == 1) {
-            SDL_PauseAudio(0); // start playing sound
-			SDL_Delay(1000); // wait while sound is playing
-			SDL_PauseAudio(1); // stop playing sound
-        }
         --chip->soundTimer;
+
+        if(chip->soundTimer == 0) {
+            chip->events |= CHIP8_EVENT(CHIP8_SOUND_OFF);
+        }
     }
 }
 
-// Multimedia methods
+void chip8_cycle(struct chip8* chip) {
+    uint16_t pc = chip->pc;
 
-void audio_callback(void *user_data, Uint8 *raw_buffer, int bytes) {
-	int amplitude = 28000;
-	int sample_rate = 8820;
+    step(chip);
+    tickTimers(chip);
 
-    Sint16 *buffer = (Sint16*)raw_buffer;
-    int length = bytes / 2; // 2 bytes per sample for AUDIO_S16SYS
-    int sample_nr = *(int*)user_data;
+    if(chip->events & CHIP8_EVENT(CHIP8_FAULT)) {
+        record_fault(chip, pc);
+    }
+}
 
-    for(int i = 0; i < length; i++, sample_nr++) {
-        double time = (double)sample_nr / (double)sample_rate;
-        buffer[i] = (Sint16)(amplitude * sin(2.0f * M_PI * 441.0f * time)); // render 441 HZ sine wave
+// Embedding API
+
+const char* chip8_fault_name(enum chip8Fault fault) {
+    switch(fault) {
+        case CHIP8_FAULT_ILLEGAL_OPCODE:
+            return "unknown opcode";
+        case CHIP8_FAULT_STACK_OVERFLOW:
+            return "stack overflow";
+        case CHIP8_FAULT_STACK_UNDERFLOW:
+            return "stack underflow";
+        case CHIP8_FAULT_MEMORY_RANGE:
+            return "memory access out of range";
+        default:
+            return "no fault";
     }
 }
 
-struct MultimediaLayer* makeMultimediaLayer(char const* title, int windowWidth, int windowHeight, int textureWidth, int textureHeight) {
-    struct MultimediaLayer* mult = (struct MultimediaLayer*)malloc(sizeof(struct MultimediaLayer));
+// Lowest-numbered fault raised, if there are several
+enum chip8Fault chip8_fault(struct chip8 const* chip) {
+    if(chip->faults == 0) {
+        return CHIP8_FAULT_NONE;
+    }
 
-    if(mult == NULL) {
-        printf("Error: Wasn't able to create multimedia layer.\n");
-        exit(1);
+    return (enum chip8Fault)__builtin_ctz(chip->faults);
+}
+
+// Seeds the instance's Cxkk random number generator
+void chip8_seed(struct chip8* chip, uint32_t seed) {
+    chip->rngState = seed * 2654435761u ^ 0x9E3779B9u;
+
+    if(chip->rngState == 0) {
+        chip->rngState = 1;
     }
+}
 
-	SDL_Init(SDL_INIT_VIDEO);
-	mult->window = SDL_CreateWindow(title, 0, 0, windowWidth, windowHeight, SDL_WINDOW_SHOWN);
-	mult->renderer = SDL_CreateRenderer(mult->window, -1, SDL_RENDERER_ACCELERATED);
-	mult->texture = SDL_CreateTexture(mult->renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, textureWidth, textureHeight);
-
-	//Setting up audio
-    int sample_nr = 0;
-
-    SDL_AudioSpec want;
-    want.freq = 8820; // number of samples per second
-    want.format = AUDIO_S16SYS; // sample type (here: signed short i.e. 16 bit)
-    want.channels = 1; // only one channel
-    want.samples = 2048; // buffer-size 2048
-    want.callback = audio_callback; // function SDL calls periodically to refill the buffer
-    want.userdata = &sample_nr; // counter, keeping track of current sample number
-
-    SDL_AudioSpec have;
-    if(SDL_OpenAudio(&want, &have) != 0) SDL_LogError(SDL_LOG_CATEGORY_AUDIO, "Failed to open audio: %s", SDL_GetError());
-    if(want.format != have.format) SDL_LogError(SDL_LOG_CATEGORY_AUDIO, "Failed to get the desired AudioSpec");
-
-    return mult;
-}
-
-void destroyMultimediaLayer(struct MultimediaLayer* mult) {
-    SDL_DestroyTexture(mult->texture);
-	SDL_DestroyRenderer(mult->renderer);
-	SDL_DestroyWindow(mult->window);
-	SDL_CloseAudio();
-	SDL_Quit();
-
-    free(mult);
-}
-
-bool processInput(struct MultimediaLayer* mult, uint8_t* keys) {
-    bool run = true;
-
-    SDL_Event event;
-
-	while (SDL_PollEvent(&event)) {
-		switch (event.type) {
-			case SDL_QUIT:
-				run = false;
-				break;
-			case SDL_KEYDOWN:
-				switch (event.key.keysym.sym) {
-					case SDLK_ESCAPE:
-						run = false;
-						break;
-					case SDLK_1:
-						keys[1] = 1;
-						break;
-					case SDLK_2:
-						keys[2] = 1;
-						break;
-					case SDLK_3:
-						keys[3] = 1;
-						break;
-					case SDLK_4:
-						keys[0xC] = 1;
-						break;
-					case SDLK_q:
-						keys[4] = 1;
-						break;
-					case SDLK_w:
-						keys[5] = 1;
-						break;
-					case SDLK_e:
-						keys[6] = 1;
-						break;
-					case SDLK_r:
-						keys[0xD] = 1;
-						break;
-					case SDLK_a:
-						keys[7] = 1;
-						break;
-					case SDLK_s:
-						keys[8] = 1;
-						break;
-					case SDLK_d:
-						keys[9] = 1;
-						break;
-					case SDLK_f:
-						keys[0xE] = 1;
-						break;
-					case SDLK_z:
-						keys[0xA] = 1;
-						break;
-					case SDLK_x:
-						keys[0] = 1;
-						break;
-					case SDLK_c:
-						keys[0xB] = 1;
-						break;
-					case SDLK_v:
-						keys[0xF] = 1;
-						break;
-				}
-				break;
-			case SDL_KEYUP:
-				switch (event.key.keysym.sym) {
-					case SDLK_ESCAPE:
-						run = false;
-						break;
-					case SDLK_1:
-						keys[1] = 0;
-						break;
-					case SDLK_2:
-						keys[2] = 0;
-						break;
-					case SDLK_3:
-						keys[3] = 0;
-						break;
-					case SDLK_4:
-						keys[0xC] = 0;
-						break;
-					case SDLK_q:
-						keys[4] = 0;
-						break;
-					case SDLK_w:
-						keys[5] = 0;
-						break;
-					case SDLK_e:
-						keys[6] = 0;
-						break;
-					case SDLK_r:
-						keys[0xD] = 0;
-						break;
-					case SDLK_a:
-						keys[7] = 0;
-						break;
-					case SDLK_s:
-						keys[8] = 0;
-						break;
-					case SDLK_d:
-						keys[9] = 0;
-						break;
-					case SDLK_f:
-						keys[0xE] = 0;
-						break;
-					case SDLK_z:
-						keys[0xA] = 0;
-						break;
-					case SDLK_x:
-						keys[0] = 0;
-						break;
-					case SDLK_c:
-						keys[0xB] = 0;
-						break;
-					case SDLK_v:
-						keys[0xF] = 0;
-						break;
-				}
-				break;
-		}
-	}
+// Pops the most important pending event, or CHIP8_NONE
+enum chip8Reason chip8_poll(struct chip8* chip) {
+    if(chip->events == 0) {
+        return CHIP8_NONE;
+    }
+
+    enum chip8Reason reason = (enum chip8Reason)(31 - __builtin_clz(chip->events));
+    chip->events &= ~CHIP8_EVENT(reason);
+
+    return reason;
+}
+
+// Runs up to maxCycles instructions, ticking the timers every cyclesPerFrame of them,
+// and returns as soon as something the host has to react to happens.
+// Events still pending from an earlier call are returned before anything runs.
+enum chip8Reason chip8_run(struct chip8* chip, uint32_t maxCycles) {
+    uint32_t executed = 0;
+    uint16_t pc = chip->pc;
+
+    while(chip->events == 0 && executed < maxCycles) {
+        pc = chip->pc;
+        step(chip);
+        ++executed;
+
+        if(--chip->frameCycles == 0) {
+            chip->frameCycles = chip->cyclesPerFrame;
+            tickTimers(chip);
+            chip->events |= CHIP8_EVENT(CHIP8_FRAME);
+        }
+    }
+
+    chip->executed = executed;
+
+    if(chip->events & CHIP8_EVENT(CHIP8_FAULT)) {
+        record_fault(chip, pc);
+    }
+
+    return chip->events ? chip8_poll(chip) : CHIP8_BUDGET;
+}
+
+// Runs until the timers have ticked the given number of times. Returns false if the ROM faulted.
+bool chip8_run_frames(struct chip8* chip, uint32_t frames) {
+    while(frames > 0) {
+        switch(chip8_run(chip, UINT32_MAX)) {
+            case CHIP8_FRAME:
+                --frames;
+                break;
+            case CHIP8_FAULT:
+                return false;
+            default:
+                break;
+        }
+    }
+
+    return true;
+}
+
+// COSMAC VIP timing
+
+// Approximate machine cycles the VIP interpreter spends on an instruction,
+// including its fetch/decode overhead.
+static unsigned int vip_cycles(uint16_t opcode) {
+    switch(opcode & 0xF000) {
+        case 0x0000:
+            // 00E0 clears all 256 bytes of display RAM
+            return (opcode & 0x000F) == 0x000E ? 50 : 3118;
+        case 0x1000:
+            return 52;
+        case 0x2000:
+            return 66;
+        case 0x3000:
+        case 0x4000:
+            return 54;
+        case 0x5000:
+        case 0x9000:
+            return 58;
+        case 0x6000:
+            return 46;
+        case 0x7000:
+            return 50;
+        case 0x8000:
+            return 84;
+        case 0xA000:
+            return 52;
+        case 0xB000:
+            return 62;
+        case 0xC000:
+            return 76;
+        case 0xD000:
+            // Each sprite row is shifted into place and XORed into two display bytes
+            return 108 + 68 * (opcode & 0x000F);
+        case 0xE000:
+            return 58;
+        case 0xF000:
+            switch(opcode & 0x00FF) {
+                case 0x001E:
+                case 0x0029:
+                    return 56;
+                case 0x0033:
+                    return 364;
+                case 0x0055:
+                case 0x0065:
+                    return 54 + 28 * (((opcode & 0x0F00) >> 8) + 1);
+                default:
+                    return 50;
+            }
+    }
 
-    return run;
+    return 50;
 }
 
-void updateMultimediaLayer(struct MultimediaLayer* mult, void const* buffer, int pitch) {
-	SDL_UpdateTexture(mult->texture, NULL, buffer, pitch);
-	SDL_RenderClear(mult->renderer);
-	SDL_RenderCopy(mult->renderer, mult->texture, NULL, NULL);
-	SDL_RenderPresent(mult->renderer);
+// Runs one 60 Hz frame the way the VIP would: instructions until the machine cycles
+// left over by display DMA and the interrupt routine run out, then one timer tick.
+// A sprite draw waits for the next vertical blank, so it always ends the frame.
+unsigned int chip8_run_frame(struct chip8* chip) {
+    unsigned int instructions = 0;
+
+    chip->cycleBudget += VIP_FRAME_CYCLES - VIP_DISPLAY_CYCLES;
+
+    while(chip->cycleBudget > 0) {
+        uint16_t pc = chip->pc;
+
+        step(chip);
+        ++instructions;
+
+        if(chip->events & CHIP8_EVENT(CHIP8_FAULT)) {
+            record_fault(chip, pc);
+            break;
+        }
+
+        // Overruns are charged to the next frame
+        chip->cycleBudget -= vip_cycles(chip->opcode);
+
+        if((chip->opcode & 0xF000) == 0xD000) {
+            if(chip->cycleBudget > 0) {
+                chip->cycleBudget = 0;
+            }
+            break;
+        }
+    }
+
+    tickTimers(chip);
+
+    return instructions;
+}
+
+// Instance pool
+
+struct chip8Pool* chip8_pool_create(uint32_t capacity) {
+    struct chip8Pool* pool = (struct chip8Pool*)malloc(sizeof(struct chip8Pool));
+
+    if(pool == NULL) {
+        printf("Error: Wasn't able to create instance pool.\n");
+        return NULL;
+    }
+
+    pool->slab = (struct chip8*)aligned_alloc(CACHE_LINE_SIZE, sizeof(struct chip8) * capacity);
+    pool->freeList = (uint32_t*)malloc(sizeof(uint32_t) * capacity);
+
+    if(pool->slab == NULL || pool->freeList == NULL) {
+        printf("Error: Wasn't able to allocate %u instances.\n", capacity);
+        free(pool->slab);
+        free(pool->freeList);
+        free(pool);
+        return NULL;
+    }
+
+    pool->capacity = capacity;
+    pool->freeCount = capacity;
+
+    // Touch every page now so sessions never fault on first use.
+    // Lowest slots are handed out first.
+    for (uint32_t i = 0; i < capacity; ++i) {
+        chip8_reset(&pool->slab[i]);
+        pool->freeList[i] = capacity - 1 - i;
+    }
+
+    return pool;
+}
+
+void chip8_pool_destroy(struct chip8Pool* pool) {
+    free(pool->slab);
+    free(pool->freeList);
+    free(pool);
+}
+
+// Returns a powered-on instance, or NULL when the pool is exhausted
+struct chip8* chip8_pool_acquire(struct chip8Pool* pool) {
+    if(pool->freeCount == 0) {
+        return NULL;
+    }
+
+    struct chip8* chip = &pool->slab[pool->freeList[--pool->freeCount]];
+    chip8_reset(chip);
+
+    return chip;
+}
+
+void chip8_pool_release(struct chip8Pool* pool, struct chip8* chip) {
+    uintptr_t offset = (uintptr_t)chip - (uintptr_t)pool->slab;
+
+    // Only instances from this pool, and never more releases than acquires
+    assert((uintptr_t)chip >= (uintptr_t)pool->slab && offset % sizeof(struct chip8) == 0);
+    assert(offset / sizeof(struct chip8) < pool->capacity);
+    assert(pool->freeCount < pool->capacity);
+
+    pool->freeList[pool->freeCount++] = (uint32_t)(offset / sizeof(struct chip8));
 }
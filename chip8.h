@@ -3,35 +3,119 @@
 
 #include <stdint.h>
 #include <stdbool.h>
-#include <SDL2/SDL.h>
 
+#define CACHE_LINE_SIZE 64
+
+// Why chip8_run returned; each reason also has a bit in chip8.events
+enum chip8Reason {
+	CHIP8_NONE,
+	CHIP8_BUDGET,           // maxCycles instructions executed
+	CHIP8_FRAME,            // timers ticked
+	CHIP8_DISPLAY,          // 00E0 or Dxyn changed video
+	CHIP8_SOUND_ON,
+	CHIP8_SOUND_OFF,
+	CHIP8_KEY_WAIT,         // Fx0A is waiting for a key press
+	CHIP8_FAULT,            // see chip8_fault(), faultPc and faultOpcode
+};
+
+// Each fault also has a bit in chip8.faults
+enum chip8Fault {
+	CHIP8_FAULT_NONE = -1,
+	CHIP8_FAULT_ILLEGAL_OPCODE,
+	CHIP8_FAULT_STACK_OVERFLOW,     // 2nnn with all 16 levels in use
+	CHIP8_FAULT_STACK_UNDERFLOW,    // 00EE with an empty stack
+	CHIP8_FAULT_MEMORY_RANGE,       // I-relative access, or instruction fetch, past the end of memory
+};
+
+#define CHIP8_EVENT(reason) (1u << (reason))
+
+// Interpreter state touched by every instruction shares the first cache line,
+// stack and keypad the second, and the big arrays follow.
 struct chip8 {
-	uint8_t keypad[16];
-	uint32_t video[64 * 32];
-	uint8_t memory[4096];
-	uint8_t registers[16];
-	uint16_t index;
 	uint16_t pc;
+	uint16_t index;
+	uint16_t opcode;
+	uint8_t sp;
 	uint8_t delayTimer;
 	uint8_t soundTimer;
-	uint16_t stack[16];
-	uint8_t sp;
-	uint16_t opcode;
+	uint8_t events;
+	uint8_t registers[16];
+	int32_t cycleBudget;
+	uint16_t cyclesPerFrame;
+	uint16_t frameCycles;
+	uint32_t executed;
+	uint32_t rngState;
+	uint16_t stack[16] __attribute__((aligned(CACHE_LINE_SIZE)));
+	uint8_t keypad[16];
+	uint8_t faults;
+	uint16_t faultPc;
+	uint16_t faultOpcode;
+	uint8_t memory[4096];
+	uint32_t video[64 * 32] __attribute__((aligned(CACHE_LINE_SIZE)));
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+// Fixed-capacity slab of instances for hosts that start and stop many sessions
+struct chip8Pool {
+	struct chip8* slab;
+	uint32_t* freeList;
+	uint32_t capacity;
+	uint32_t freeCount;
 };
 
-struct chip8* init();
-void load(struct chip8*, const char*);
-void cycle(struct chip8*);
+// chip8_init() returns NULL and chip8_load() false on failure; a faulting ROM raises CHIP8_FAULT instead of exiting
+struct chip8* chip8_init(void);
+void chip8_reset(struct chip8*);
+void chip8_destroy(struct chip8*);
+bool chip8_load(struct chip8*, const char*);
+void chip8_cycle(struct chip8*);
+unsigned int chip8_run_frame(struct chip8*);
+
+enum chip8Reason chip8_run(struct chip8*, uint32_t);
+bool chip8_run_frames(struct chip8*, uint32_t);
+enum chip8Reason chip8_poll(struct chip8*);
+void chip8_seed(struct chip8*, uint32_t);
+enum chip8Fault chip8_fault(struct chip8 const*);
+const char* chip8_fault_name(enum chip8Fault);
+
+struct chip8Pool* chip8_pool_create(uint32_t);
+void chip8_pool_destroy(struct chip8Pool*);
+struct chip8* chip8_pool_acquire(struct chip8Pool*);
+void chip8_pool_release(struct chip8Pool*, struct chip8*);
+
+#ifdef CHIP8_FUZZ
+#define FUZZ_MAP_SIZE 65536
+
+extern uint8_t fuzzCoverage[FUZZ_MAP_SIZE];
+extern uint16_t fuzzPrevPc;
+#endif
 
-struct MultimediaLayer {
-	SDL_Window* window;
-	SDL_Renderer* renderer;
-	SDL_Texture* texture;
+#ifdef CHIP8_PROFILE
+#include <stdio.h>
+
+#define PROFILE_MAX_SMC_EVENTS 64
+
+// A write to an address that had already been fetched as code
+struct smcEvent {
+	uint16_t pc;
+	uint16_t opcode;
+	uint16_t address;
 };
 
-struct MultimediaLayer* makeMultimediaLayer(char const*, int, int, int, int);
-void destroyMultimediaLayer(struct MultimediaLayer*);
-bool processInput(struct MultimediaLayer*, uint8_t*);
-void updateMultimediaLayer(struct MultimediaLayer*, void const*, int);
+// Shadow access counters for every byte of chip8 memory
+struct memoryProfile {
+	uint32_t fetches[4096];
+	uint32_t spriteReads[4096];
+	uint32_t dataReads[4096];
+	uint32_t writes[4096];
+	uint32_t smcWrites[4096];       // writes to the byte after it had been fetched
+	uint32_t smcCount;
+	uint32_t smcEventCount;
+	struct smcEvent smcEvents[PROFILE_MAX_SMC_EVENTS];
+};
+
+extern struct memoryProfile memoryProfile;
+
+void writeMemoryProfile(FILE*);
+#endif
 
 #endif
\ No newline at end of file
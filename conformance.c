@@ -0,0 +1,425 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdarg.h>
+
+#include "chip8.h"
+#include "savestate.h"
+
+#define MAX_CASES 256
+#define MAX_STEPS 64
+#define MAX_LINE 512
+
+enum stepKind {
+	STEP_PRESS,
+	STEP_RELEASE,
+	STEP_EXPECT,
+	STEP_SOUND,
+	STEP_SAVE,
+};
+
+// A scripted input change, a framebuffer or buzzer checkpoint or a save state, after the given number of frames
+struct step {
+	enum stepKind kind;
+	uint32_t frame;
+	uint8_t key;
+	bool sound;
+	char* path;
+	bool recorded;
+	uint64_t hash;
+	int line;
+
+	bool reached;
+	uint64_t actual;
+};
+
+enum outcome {
+	OUTCOME_PASS,
+	OUTCOME_FAIL,
+	OUTCOME_SKIP,
+};
+
+struct testCase {
+	char name[64];
+	char rom[256];
+	uint16_t cyclesPerFrame;
+	struct step steps[MAX_STEPS];
+	int stepCount;
+
+	enum outcome outcome;
+	char message[256];
+};
+
+static struct testCase cases[MAX_CASES];
+static int caseCount = 0;
+static atomic_int nextCase;
+
+// FNV-1a over the framebuffer packed to one bit per pixel
+static uint64_t hashFrame(struct chip8 const* chip) {
+	uint64_t hash = 14695981039346656037ull;
+
+	for (int i = 0; i < 64 * 32; i += 8) {
+		uint8_t byte = 0;
+
+		for (int bit = 0; bit < 8; ++bit) {
+			byte = byte << 1 | (chip->video[i + bit] & 1u);
+		}
+
+		hash = (hash ^ byte) * 1099511628211ull;
+	}
+
+	return hash;
+}
+
+static int compareSteps(const void* a, const void* b) {
+	struct step const* left = (struct step const*)a;
+	struct step const* right = (struct step const*)b;
+
+	if (left->frame != right->frame) {
+		return left->frame < right->frame ? -1 : 1;
+	}
+
+	// Input for a frame applies before that frame's checkpoints
+	int checkpoint = (left->kind >= STEP_EXPECT) - (right->kind >= STEP_EXPECT);
+	if (checkpoint != 0) {
+		return checkpoint;
+	}
+
+	// qsort isn't stable, keep the manifest order otherwise
+	return left->line - right->line;
+}
+
+static bool parseManifest(const char* path) {
+	FILE* file = fopen(path, "r");
+	if (file == NULL) {
+		printf("Error: Failed to open %s\n", path);
+		return false;
+	}
+
+	char line[MAX_LINE];
+	int lineNumber = 0;
+	struct testCase* current = NULL;
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		++lineNumber;
+
+		char* comment = strchr(line, '#');
+		if (comment != NULL) {
+			*comment = '\0';
+		}
+
+		char keyword[16];
+		if (sscanf(line, "%15s", keyword) != 1) {
+			continue;
+		}
+
+		if (strcmp(keyword, "test") == 0) {
+			if (caseCount == MAX_CASES) {
+				printf("Error: %s:%d: too many tests\n", path, lineNumber);
+				fclose(file);
+				return false;
+			}
+
+			current = &cases[caseCount++];
+			memset(current, 0, sizeof(*current));
+			current->cyclesPerFrame = 10;
+
+			unsigned int cyclesPerFrame;
+			int fields = sscanf(line, "%*s %63s %255s %u", current->name, current->rom, &cyclesPerFrame);
+			if (fields < 2) {
+				printf("Error: %s:%d: expected test <name> <rom> [<cycles per frame>]\n", path, lineNumber);
+				fclose(file);
+				return false;
+			}
+			if (fields == 3) {
+				current->cyclesPerFrame = cyclesPerFrame;
+			}
+			continue;
+		}
+
+		if (current == NULL || current->stepCount == MAX_STEPS) {
+			printf("Error: %s:%d: step outside of a test, or too many steps\n", path, lineNumber);
+			fclose(file);
+			return false;
+		}
+
+		struct step* step = &current->steps[current->stepCount];
+		char value[256];
+		step->line = lineNumber;
+
+		if (sscanf(line, "%*s %u %255s", &step->frame, value) != 2) {
+			printf("Error: %s:%d: expected %s <frame> <value>\n", path, lineNumber, keyword);
+			fclose(file);
+			return false;
+		}
+
+		if (strcmp(keyword, "press") == 0 || strcmp(keyword, "release") == 0) {
+			step->kind = keyword[0] == 'p' ? STEP_PRESS : STEP_RELEASE;
+			step->key = strtoul(value, NULL, 16) & 0xFu;
+		}
+		else if (strcmp(keyword, "expect") == 0) {
+			step->kind = STEP_EXPECT;
+			step->recorded = strcmp(value, "-") != 0;
+			step->hash = strtoull(value, NULL, 16);
+		}
+		else if (strcmp(keyword, "sound") == 0) {
+			step->kind = STEP_SOUND;
+			step->sound = strcmp(value, "on") == 0;
+		}
+		else if (strcmp(keyword, "save") == 0) {
+			step->kind = STEP_SAVE;
+			step->path = strdup(value);
+		}
+		else {
+			printf("Error: %s:%d: unknown keyword %s\n", path, lineNumber, keyword);
+			fclose(file);
+			return false;
+		}
+
+		++current->stepCount;
+	}
+
+	fclose(file);
+
+	for (int i = 0; i < caseCount; ++i) {
+		qsort(cases[i].steps, cases[i].stepCount, sizeof(struct step), compareSteps);
+	}
+
+	return true;
+}
+
+static void setOutcome(struct testCase* test, enum outcome outcome, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	vsnprintf(test->message, sizeof(test->message), format, args);
+	va_end(args);
+
+	test->outcome = outcome;
+}
+
+static bool hasExtension(const char* path, const char* extension) {
+	size_t length = strlen(path);
+	size_t extensionLength = strlen(extension);
+
+	return length > extensionLength && strcmp(path + length - extensionLength, extension) == 0;
+}
+
+// Writes a save state, reads it back into the spare instance and checks it matches.
+// The spare then continues the test, so later checkpoints also cover the restored state.
+static bool saveAndRestore(struct chip8** chip, struct chip8** spare, const char* path) {
+	if (!chip8_save_state(*chip, path) || !chip8_load_state(*spare, path)) {
+		return false;
+	}
+
+	// Restoring flags a redraw, which the original doesn't have pending
+	(*spare)->events = (*chip)->events;
+	if (memcmp(*chip, *spare, sizeof(struct chip8)) != 0) {
+		return false;
+	}
+
+	struct chip8* restored = *spare;
+	*spare = *chip;
+	*chip = restored;
+
+	return true;
+}
+
+static void runCase(struct testCase* test, struct chip8* chip, struct chip8* spare) {
+	if (access(test->rom, R_OK) != 0) {
+		setOutcome(test, OUTCOME_SKIP, "%s not found", test->rom);
+		return;
+	}
+
+	chip8_reset(chip);
+	chip8_seed(chip, 0);
+	chip->cyclesPerFrame = test->cyclesPerFrame;
+	chip->frameCycles = test->cyclesPerFrame;
+
+	// A save state as the ROM warm-starts from that checkpoint
+	bool loaded = hasExtension(test->rom, ".c8s") ? chip8_load_state(chip, test->rom) : chip8_load(chip, test->rom);
+	if (!loaded) {
+		setOutcome(test, OUTCOME_FAIL, "failed to load %s", test->rom);
+		return;
+	}
+
+	uint32_t frame = 0;
+	bool unrecorded = false;
+	test->outcome = OUTCOME_PASS;
+
+	for (int i = 0; i < test->stepCount; ++i) {
+		struct step* step = &test->steps[i];
+
+		if (!chip8_run_frames(chip, step->frame - frame)) {
+			setOutcome(test, OUTCOME_FAIL, "%s at pc %03X (%04X) before frame %u",
+				chip8_fault_name(chip8_fault(chip)), chip->faultPc, chip->faultOpcode, step->frame);
+			return;
+		}
+		frame = step->frame;
+
+		switch (step->kind) {
+			case STEP_PRESS:
+				chip->keypad[step->key] = 1;
+				break;
+			case STEP_RELEASE:
+				chip->keypad[step->key] = 0;
+				break;
+			case STEP_EXPECT:
+				step->actual = hashFrame(chip);
+				step->reached = true;
+
+				if (!step->recorded) {
+					unrecorded = true;
+				}
+				else if (step->actual != step->hash && test->outcome == OUTCOME_PASS) {
+					setOutcome(test, OUTCOME_FAIL, "frame %u: expected %016llx, got %016llx",
+						frame, (unsigned long long)step->hash, (unsigned long long)step->actual);
+				}
+				break;
+			case STEP_SOUND:
+				if ((chip->soundTimer > 0) != step->sound && test->outcome == OUTCOME_PASS) {
+					setOutcome(test, OUTCOME_FAIL, "frame %u: expected the buzzer %s", frame, step->sound ? "on" : "off");
+				}
+				break;
+			case STEP_SAVE:
+				if (!saveAndRestore(&chip, &spare, step->path)) {
+					setOutcome(test, OUTCOME_FAIL, "frame %u: save state does not round-trip", frame);
+					return;
+				}
+				break;
+		}
+	}
+
+	if (unrecorded && test->outcome == OUTCOME_PASS) {
+		setOutcome(test, OUTCOME_SKIP, "no golden hash, record it with -u");
+	}
+}
+
+static void* worker(void* unused) {
+	(void)unused;
+
+	struct chip8* chip = chip8_init();
+	struct chip8* spare = chip8_init();
+	if (chip == NULL || spare == NULL) {
+		return NULL;
+	}
+
+	int i;
+	while ((i = atomic_fetch_add(&nextCase, 1)) < caseCount) {
+		runCase(&cases[i], chip, spare);
+	}
+
+	chip8_destroy(chip);
+	chip8_destroy(spare);
+
+	return NULL;
+}
+
+// Rewrites the expect lines of the manifest with the hashes just computed
+static bool recordGoldens(const char* path) {
+	FILE* in = fopen(path, "r");
+	if (in == NULL) {
+		printf("Error: Failed to open %s\n", path);
+		return false;
+	}
+
+	char tempPath[512];
+	snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+
+	FILE* out = fopen(tempPath, "w");
+	if (out == NULL) {
+		printf("Error: Failed to write %s\n", tempPath);
+		fclose(in);
+		return false;
+	}
+
+	char line[MAX_LINE];
+	int lineNumber = 0;
+
+	while (fgets(line, sizeof(line), in) != NULL) {
+		++lineNumber;
+		struct step const* found = NULL;
+
+		for (int i = 0; i < caseCount && found == NULL; ++i) {
+			for (int j = 0; j < cases[i].stepCount; ++j) {
+				struct step const* step = &cases[i].steps[j];
+				if (step->line == lineNumber && step->reached) {
+					found = step;
+					break;
+				}
+			}
+		}
+
+		if (found != NULL) {
+			fprintf(out, "expect %u %016llx\n", found->frame, (unsigned long long)found->actual);
+		}
+		else {
+			fputs(line, out);
+		}
+	}
+
+	fclose(in);
+	fclose(out);
+
+	return rename(tempPath, path) == 0;
+}
+
+int main(int argc, char* argv[]) {
+	bool record = argc == 3 && strcmp(argv[1], "-u") == 0;
+
+	if (argc != 2 && !record) {
+		printf("Usage: %s [-u] <Manifest>\n", argv[0]);
+		exit(1);
+	}
+
+	const char* manifest = argv[argc - 1];
+	if (!parseManifest(manifest)) {
+		exit(1);
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	long threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+	if (threadCount < 1) threadCount = 1;
+	if (threadCount > caseCount) threadCount = caseCount > 0 ? caseCount : 1;
+
+	pthread_t threads[64];
+	if (threadCount > 64) threadCount = 64;
+
+	atomic_init(&nextCase, 0);
+	for (long i = 0; i < threadCount; ++i) {
+		pthread_create(&threads[i], NULL, worker, NULL);
+	}
+	for (long i = 0; i < threadCount; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	int counts[3] = {0};
+	for (int i = 0; i < caseCount; ++i) {
+		static const char* labels[] = { "PASS", "FAIL", "SKIP" };
+		struct testCase const* test = &cases[i];
+
+		++counts[test->outcome];
+		printf("%s %s%s%s\n", labels[test->outcome], test->name, test->message[0] ? ": " : "", test->message);
+	}
+
+	printf("%d passed, %d failed, %d skipped in %.2fs\n", counts[OUTCOME_PASS], counts[OUTCOME_FAIL], counts[OUTCOME_SKIP],
+		(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+
+	if (record) {
+		if (!recordGoldens(manifest)) {
+			printf("Error: Failed to update %s\n", manifest);
+			exit(1);
+		}
+		printf("Recorded golden hashes in %s\n", manifest);
+		return 0;
+	}
+
+	return counts[OUTCOME_FAIL] > 0 ? 1 : 0;
+}
@@ -0,0 +1,263 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "emulator.h"
+#include "metrics.h"
+#include "savestate.h"
+
+#define FRAME_FRESH 0x4u
+// Instructions (or VIP frames) run per wakeup when uncapped
+#define UNCAPPED_STEPS 64
+// Frames are published at most this often while fast-forwarding
+#define TURBO_PRESENT_RATE 60
+
+// Key queue
+
+bool pushKeyEvent(struct emulator* emu, uint8_t key, uint8_t pressed) {
+	uint32_t head = atomic_load_explicit(&emu->keys.head, memory_order_relaxed);
+	uint32_t tail = atomic_load_explicit(&emu->keys.tail, memory_order_acquire);
+
+	if (head - tail == KEY_QUEUE_SIZE) {
+		return false;
+	}
+
+	emu->keys.events[head % KEY_QUEUE_SIZE] = (uint16_t)(pressed << 8 | key);
+	atomic_store_explicit(&emu->keys.head, head + 1, memory_order_release);
+
+	return true;
+}
+
+static void drainKeyEvents(struct emulator* emu) {
+	uint32_t tail = atomic_load_explicit(&emu->keys.tail, memory_order_relaxed);
+	uint32_t head = atomic_load_explicit(&emu->keys.head, memory_order_acquire);
+
+	for (; tail != head; ++tail) {
+		uint16_t event = emu->keys.events[tail % KEY_QUEUE_SIZE];
+		emu->chip->keypad[event & 0xFu] = event >> 8;
+	}
+
+	atomic_store_explicit(&emu->keys.tail, tail, memory_order_release);
+}
+
+// Frame exchange
+
+static void publishFrame(struct emulator* emu) {
+	struct frameExchange* ex = &emu->frames;
+
+	memcpy(ex->frames[ex->back], emu->chip->video, sizeof(ex->frames[0]));
+	uint8_t previous = atomic_exchange_explicit(&ex->middle, ex->back | FRAME_FRESH, memory_order_acq_rel);
+	ex->back = previous & 0x3u;
+
+	metricsAdd(&metrics.emulation.framesPublished, 1);
+	if (previous & FRAME_FRESH) {
+		metricsAdd(&metrics.emulation.framesDropped, 1);
+	}
+}
+
+// Returns the newest finished frame, or NULL if nothing was published since the last call
+uint32_t const* latestFrame(struct emulator* emu) {
+	struct frameExchange* ex = &emu->frames;
+
+	if (!(atomic_load_explicit(&ex->middle, memory_order_relaxed) & FRAME_FRESH)) {
+		return NULL;
+	}
+
+	ex->front = atomic_exchange_explicit(&ex->middle, ex->front, memory_order_acq_rel) & 0x3u;
+
+	return ex->frames[ex->front];
+}
+
+// Emulation thread
+
+void setEmulatorSpeed(struct emulator* emu, uint32_t speed) {
+	atomic_store_explicit(&emu->speed, speed, memory_order_relaxed);
+}
+
+// Asks the emulation thread to write a save state between instructions.
+// Returns false if the previous request hasn't been handled yet.
+bool requestSave(struct emulator* emu, const char* path) {
+	if (atomic_load_explicit(&emu->saveRequested, memory_order_acquire)) {
+		return false;
+	}
+
+	snprintf(emu->savePath, sizeof(emu->savePath), "%s", path);
+	atomic_store_explicit(&emu->saveRequested, true, memory_order_release);
+
+	return true;
+}
+
+static void handleSaveRequest(struct emulator* emu) {
+	if (!atomic_load_explicit(&emu->saveRequested, memory_order_acquire)) {
+		return;
+	}
+
+	if (chip8_save_state(emu->chip, emu->savePath)) {
+		printf("Saved %s\n", emu->savePath);
+	}
+
+	atomic_store_explicit(&emu->saveRequested, false, memory_order_release);
+}
+
+// The buzzer is muted while fast-forwarding
+static void updateBuzzer(struct emulator* emu) {
+	bool pause = !(emu->soundOn && emu->currentSpeed == 1);
+	uint64_t start = metricsNow();
+
+	// Takes the audio device lock, so it can wait for the callback to finish
+	SDL_PauseAudio(pause);
+
+	uint64_t end = metricsNow();
+	metricsAdd(&metrics.emulation.audioBlockedNs, end - start);
+	if (!pause) {
+		metricsSet(&metrics.emulation.audioResumed, end);
+	}
+}
+
+static void handleEvents(struct emulator* emu) {
+	enum chip8Reason reason;
+
+	while ((reason = chip8_poll(emu->chip)) != CHIP8_NONE) {
+		switch (reason) {
+			case CHIP8_DISPLAY:
+				if (emu->framePending) {
+					metricsAdd(&metrics.emulation.framesSkipped, 1);
+				}
+				emu->framePending = true;
+				break;
+			case CHIP8_SOUND_ON:
+				emu->soundOn = true;
+				updateBuzzer(emu);
+				break;
+			case CHIP8_SOUND_OFF:
+				emu->soundOn = false;
+				updateBuzzer(emu);
+				break;
+			case CHIP8_FAULT:
+				atomic_store_explicit(&emu->faulted, true, memory_order_release);
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+// Once this returns true the emulation thread has stopped; the fault is in the instance
+bool emulatorFaulted(struct emulator* emu) {
+	return atomic_load_explicit(&emu->faulted, memory_order_acquire);
+}
+
+static int emulationThread(void* data) {
+	struct emulator* emu = (struct emulator*)data;
+
+	// VIP timing runs a whole frame's worth of instructions per 60 Hz tick
+	uint64_t frequency = SDL_GetPerformanceFrequency();
+	uint64_t period = emu->vipTiming ? frequency / 60 : frequency * emu->cycleDelay / 1000;
+	uint64_t next = SDL_GetPerformanceCounter();
+
+	while (atomic_load_explicit(&emu->running, memory_order_relaxed) && !emulatorFaulted(emu)) {
+		drainKeyEvents(emu);
+		handleSaveRequest(emu);
+
+		uint32_t speed = atomic_load_explicit(&emu->speed, memory_order_relaxed);
+		if (speed != emu->currentSpeed) {
+			emu->currentSpeed = speed;
+			updateBuzzer(emu);
+		}
+
+		uint64_t now = SDL_GetPerformanceCounter();
+		if (speed != TURBO_UNCAPPED && now < next) {
+			// Sleep off whole milliseconds only, spin the remainder
+			if ((next - now) * 1000 / frequency > 1) {
+				SDL_Delay(1);
+			}
+			continue;
+		}
+
+		// Pace against a fixed schedule instead of the last wakeup so jitter doesn't accumulate,
+		// but don't try to catch up on time lost to a long stall. Uncapped keeps no schedule.
+		if (speed == TURBO_UNCAPPED) {
+			next = now;
+		}
+		else {
+			next = next + period > now ? next + period : now + period;
+		}
+
+		// At N times speed a wakeup runs N steps, so timers still tick once per emulated step or frame
+		unsigned int steps = speed == TURBO_UNCAPPED ? UNCAPPED_STEPS : speed;
+		uint64_t instructions = 0;
+		uint64_t start = metricsNow();
+
+		for (unsigned int i = 0; i < steps; ++i) {
+			if (emu->vipTiming) {
+				instructions += chip8_run_frame(emu->chip);
+			}
+			else {
+				chip8_cycle(emu->chip);
+				++instructions;
+			}
+
+			handleEvents(emu);
+
+			if (emulatorFaulted(emu)) {
+				break;
+			}
+		}
+
+		metricsAdd(&metrics.emulation.instructions, instructions);
+		metricsAdd(&metrics.emulation.busyNs, metricsNow() - start);
+
+		// While fast-forwarding only the newest frame per display refresh is presented
+		if (emu->framePending) {
+			now = SDL_GetPerformanceCounter();
+
+			if (speed == 1 || now >= emu->nextPresent) {
+				publishFrame(emu);
+				emu->framePending = false;
+				emu->nextPresent = now + frequency / TURBO_PRESENT_RATE;
+			}
+		}
+	}
+
+	return 0;
+}
+
+struct emulator* startEmulator(struct chip8* chip, int cycleDelay, bool vipTiming) {
+	struct emulator* emu = (struct emulator*)aligned_alloc(CACHE_LINE_SIZE, sizeof(struct emulator));
+
+	if (emu == NULL) {
+		printf("Error: Wasn't able to create emulation thread.\n");
+		exit(1);
+	}
+
+	memset(emu, 0, sizeof(struct emulator));
+	emu->chip = chip;
+	emu->cycleDelay = cycleDelay;
+	emu->vipTiming = vipTiming;
+	emu->frames.back = 0;
+	emu->frames.front = 1;
+	atomic_init(&emu->frames.middle, 2);
+	atomic_init(&emu->keys.head, 0);
+	atomic_init(&emu->keys.tail, 0);
+	atomic_init(&emu->running, true);
+	atomic_init(&emu->faulted, false);
+	atomic_init(&emu->speed, 1);
+	atomic_init(&emu->saveRequested, false);
+	emu->currentSpeed = 1;
+
+	emu->thread = SDL_CreateThread(emulationThread, "chip8", emu);
+	if (emu->thread == NULL) {
+		printf("Error: Wasn't able to create emulation thread.\n");
+		exit(1);
+	}
+
+	return emu;
+}
+
+void stopEmulator(struct emulator* emu) {
+	atomic_store(&emu->running, false);
+	SDL_WaitThread(emu->thread, NULL);
+
+	free(emu);
+}
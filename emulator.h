@@ -0,0 +1,62 @@
+#ifndef EMULATOR_H
+#define EMULATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <SDL2/SDL.h>
+
+#include "chip8.h"
+
+#define KEY_QUEUE_SIZE 64
+
+// Emulation speed multiplier; 1 is real time, TURBO_UNCAPPED runs as fast as the host allows
+#define TURBO_UNCAPPED 0
+
+// Triple buffer: the emulation thread always owns one buffer to draw into,
+// the render thread owns one to present, and the third is swapped between them.
+struct frameExchange {
+	uint32_t frames[3][64 * 32];
+	_Atomic uint8_t middle;
+	uint8_t back;
+	uint8_t front;
+};
+
+// Single-producer/single-consumer ring of key events, render thread -> emulation thread
+struct keyQueue {
+	uint16_t events[KEY_QUEUE_SIZE];
+	_Atomic uint32_t head __attribute__((aligned(CACHE_LINE_SIZE)));
+	_Atomic uint32_t tail __attribute__((aligned(CACHE_LINE_SIZE)));
+};
+
+struct emulator {
+	struct chip8* chip;
+	int cycleDelay;
+	bool vipTiming;
+	atomic_bool running;
+	// Set by the emulation thread when the ROM faulted; it stops, the main thread reports and tears down
+	atomic_bool faulted;
+	_Atomic uint32_t speed;
+	// Set by the render thread once savePath is filled in, cleared once the state is written
+	atomic_bool saveRequested;
+	char savePath[256];
+	SDL_Thread* thread;
+	struct keyQueue keys;
+	struct frameExchange frames;
+
+	// Owned by the emulation thread
+	uint32_t currentSpeed;
+	bool soundOn;
+	bool framePending;
+	uint64_t nextPresent;
+};
+
+struct emulator* startEmulator(struct chip8*, int, bool);
+void stopEmulator(struct emulator*);
+void setEmulatorSpeed(struct emulator*, uint32_t);
+bool requestSave(struct emulator*, const char*);
+bool emulatorFaulted(struct emulator*);
+bool pushKeyEvent(struct emulator*, uint8_t, uint8_t);
+uint32_t const* latestFrame(struct emulator*);
+
+#endif
@@ -0,0 +1,182 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "env.h"
+
+static int64_t readScore(struct chip8Env const* env, struct chip8 const* chip) {
+	struct chip8EnvConfig const* config = &env->config;
+	int64_t score = 0;
+
+	for (uint8_t i = 0; i < config->scoreLength; ++i) {
+		uint8_t byte = chip->memory[(config->scoreAddress + i) & 0xFFFu];
+		score = config->scoreEncoding == SCORE_BCD ? score * 10 + byte % 10 : score << 8 | byte;
+	}
+
+	return score;
+}
+
+static bool isDone(struct chip8Env const* env, uint32_t i) {
+	struct chip8EnvConfig const* config = &env->config;
+	struct chip8 const* chip = env->instances[i];
+
+	if (config->maxFrames > 0 && env->frames[i] >= config->maxFrames) {
+		return true;
+	}
+
+	return config->doneMask != 0 && (chip->memory[config->doneAddress & 0xFFFu] & config->doneMask) == config->doneValue;
+}
+
+static void writeObservation(struct chip8Env const* env, struct chip8 const* chip, uint8_t* out) {
+	if (env->config.observation == OBSERVATION_BYTES) {
+		for (int i = 0; i < 64 * 32; ++i) {
+			out[i] = chip->video[i] & 1u;
+		}
+		return;
+	}
+
+	for (int i = 0; i < 64 * 32 / 8; ++i) {
+		uint32_t const* pixels = &chip->video[8 * i];
+		uint8_t byte = 0;
+
+		for (int bit = 0; bit < 8; ++bit) {
+			byte = byte << 1 | (pixels[bit] & 1u);
+		}
+
+		out[i] = byte;
+	}
+}
+
+// Seed for an instance's later episodes. Adding the episode number to the seed would
+// give instance i's episode k the seed of instance i + k's first episode, so (seed, episode)
+// is hashed instead, with the splitmix64 finalizer.
+static uint32_t episodeSeed(uint32_t seed, uint32_t episode) {
+	uint64_t z = ((uint64_t)seed << 32 | episode) + 0x9E3779B97F4A7C15ull;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	z ^= z >> 31;
+
+	return (uint32_t)(z ^ (z >> 32));
+}
+
+static void resetInstance(struct chip8Env* env, uint32_t i, uint32_t seed) {
+	struct chip8* chip = env->instances[i];
+
+	memcpy(chip, env->pristine, sizeof(struct chip8));
+	chip8_seed(chip, seed);
+
+	env->frames[i] = 0;
+	env->scores[i] = readScore(env, chip);
+	env->finished[i] = false;
+}
+
+struct chip8Env* chip8_env_create(const char* rom, uint32_t count, struct chip8EnvConfig const* config) {
+	struct chip8Env* env = (struct chip8Env*)calloc(1, sizeof(struct chip8Env));
+
+	if (env == NULL) {
+		printf("Error: Wasn't able to create environment.\n");
+		return NULL;
+	}
+
+	env->config = *config;
+	env->count = count;
+	if (env->config.frameSkip == 0) {
+		env->config.frameSkip = 1;
+	}
+
+	env->pool = chip8_pool_create(count);
+	env->pristine = chip8_init();
+	env->instances = (struct chip8**)malloc(sizeof(struct chip8*) * count);
+	env->seeds = (uint32_t*)calloc(count, sizeof(uint32_t));
+	env->episodes = (uint32_t*)calloc(count, sizeof(uint32_t));
+	env->frames = (uint32_t*)calloc(count, sizeof(uint32_t));
+	env->scores = (int64_t*)calloc(count, sizeof(int64_t));
+	env->finished = (bool*)calloc(count, sizeof(bool));
+
+	if (env->pool == NULL || env->pristine == NULL || env->instances == NULL || env->seeds == NULL ||
+		env->episodes == NULL || env->frames == NULL || env->scores == NULL || env->finished == NULL) {
+		printf("Error: Wasn't able to allocate %u environments.\n", count);
+		chip8_env_destroy(env);
+		return NULL;
+	}
+
+	if (!chip8_load(env->pristine, rom)) {
+		chip8_env_destroy(env);
+		return NULL;
+	}
+
+	if (config->cyclesPerFrame > 0) {
+		env->pristine->cyclesPerFrame = config->cyclesPerFrame;
+		env->pristine->frameCycles = config->cyclesPerFrame;
+	}
+
+	for (uint32_t i = 0; i < count; ++i) {
+		env->instances[i] = chip8_pool_acquire(env->pool);
+	}
+
+	return env;
+}
+
+void chip8_env_destroy(struct chip8Env* env) {
+	if (env->pool != NULL) {
+		chip8_pool_destroy(env->pool);
+	}
+	if (env->pristine != NULL) {
+		chip8_destroy(env->pristine);
+	}
+
+	free(env->instances);
+	free(env->seeds);
+	free(env->episodes);
+	free(env->frames);
+	free(env->scores);
+	free(env->finished);
+	free(env);
+}
+
+size_t chip8_env_observation_size(struct chip8Env const* env) {
+	return env->config.observation == OBSERVATION_BYTES ? 64 * 32 : 64 * 32 / 8;
+}
+
+// Resets every instance with its own seed and writes the first observations
+void chip8_env_reset(struct chip8Env* env, uint32_t const* seeds, uint8_t* observations) {
+	size_t observationSize = chip8_env_observation_size(env);
+
+	for (uint32_t i = 0; i < env->count; ++i) {
+		env->seeds[i] = seeds[i];
+		env->episodes[i] = 0;
+		resetInstance(env, i, seeds[i]);
+		writeObservation(env, env->instances[i], observations + i * observationSize);
+	}
+}
+
+// Applies one keypad bitmask per instance (bit k = key k) for frameSkip frames.
+// Instances that finished on the previous step start a new episode first,
+// reseeded from their seed and the episode number.
+void chip8_env_step(struct chip8Env* env, uint16_t const* actions, uint8_t* observations, float* rewards, uint8_t* dones) {
+	size_t observationSize = chip8_env_observation_size(env);
+
+	for (uint32_t i = 0; i < env->count; ++i) {
+		struct chip8* chip = env->instances[i];
+
+		if (env->finished[i]) {
+			resetInstance(env, i, episodeSeed(env->seeds[i], ++env->episodes[i]));
+		}
+
+		for (int key = 0; key < 16; ++key) {
+			chip->keypad[key] = (actions[i] >> key) & 1u;
+		}
+
+		bool faulted = !chip8_run_frames(chip, env->config.frameSkip);
+		env->frames[i] += env->config.frameSkip;
+
+		int64_t score = readScore(env, chip);
+		rewards[i] = (float)(score - env->scores[i]);
+		env->scores[i] = score;
+
+		env->finished[i] = faulted || isDone(env, i);
+		dones[i] = env->finished[i];
+
+		writeObservation(env, chip, observations + i * observationSize);
+	}
+}
@@ -0,0 +1,56 @@
+#ifndef ENV_H
+#define ENV_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "chip8.h"
+
+enum observationFormat {
+	OBSERVATION_BITS,   // 256 bytes per instance, one bit per pixel, rows top to bottom, MSB is leftmost
+	OBSERVATION_BYTES,  // 2048 bytes per instance, 0 or 1 per pixel
+};
+
+enum scoreEncoding {
+	SCORE_BINARY,       // big-endian unsigned integer
+	SCORE_BCD,          // one decimal digit per byte, most significant first (as written by Fx33)
+};
+
+struct chip8EnvConfig {
+	uint32_t frameSkip;             // 60 Hz frames emulated per step
+	uint16_t cyclesPerFrame;
+	uint32_t maxFrames;             // 0 = no time limit
+	enum observationFormat observation;
+
+	// Reward is the change of the score stored at scoreAddress; scoreLength 0 disables it
+	uint16_t scoreAddress;
+	uint8_t scoreLength;
+	enum scoreEncoding scoreEncoding;
+
+	// An episode ends when (memory[doneAddress] & doneMask) == doneValue; doneMask 0 disables it
+	uint16_t doneAddress;
+	uint8_t doneMask;
+	uint8_t doneValue;
+};
+
+// N instances of one ROM stepped in lockstep. All buffers are allocated once at creation.
+struct chip8Env {
+	struct chip8EnvConfig config;
+	struct chip8Pool* pool;
+	struct chip8** instances;
+	struct chip8* pristine;
+	uint32_t count;
+	uint32_t* seeds;
+	uint32_t* episodes;
+	uint32_t* frames;
+	int64_t* scores;
+	bool* finished;
+};
+
+struct chip8Env* chip8_env_create(const char*, uint32_t, struct chip8EnvConfig const*);
+void chip8_env_destroy(struct chip8Env*);
+size_t chip8_env_observation_size(struct chip8Env const*);
+void chip8_env_reset(struct chip8Env*, uint32_t const*, uint8_t*);
+void chip8_env_step(struct chip8Env*, uint16_t const*, uint8_t*, float*, uint8_t*);
+
+#endif
@@ -0,0 +1,82 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "env.h"
+
+#define ROM "tests/roms/episode.ch8"
+#define INSTANCES 4
+#define EPISODES 4
+
+static int failures = 0;
+
+static void check(bool passed, char const* what) {
+	printf("%s %s\n", passed ? "PASS" : "FAIL", what);
+	failures += !passed;
+}
+
+// Every step of tests/roms/episode.ch8 is one episode whose reward is the two Cxkk bytes it drew
+static bool runEpisodes(uint32_t const* seeds, float rewards[EPISODES][INSTANCES], bool* allDone) {
+	struct chip8EnvConfig config;
+	memset(&config, 0, sizeof(config));
+	config.frameSkip = 1;
+	config.cyclesPerFrame = 20;
+	config.observation = OBSERVATION_BITS;
+	config.scoreAddress = 0x400;
+	config.scoreLength = 2;
+	config.scoreEncoding = SCORE_BINARY;
+	config.doneAddress = 0x410;
+	config.doneMask = 1;
+	config.doneValue = 1;
+
+	struct chip8Env* env = chip8_env_create(ROM, INSTANCES, &config);
+	if (env == NULL) {
+		return false;
+	}
+
+	uint8_t* observations = (uint8_t*)malloc(chip8_env_observation_size(env) * INSTANCES);
+	uint16_t actions[INSTANCES] = {0};
+	uint8_t dones[INSTANCES];
+
+	chip8_env_reset(env, seeds, observations);
+	*allDone = true;
+
+	for (int episode = 0; episode < EPISODES; ++episode) {
+		chip8_env_step(env, actions, observations, rewards[episode], dones);
+
+		for (int i = 0; i < INSTANCES; ++i) {
+			*allDone = *allDone && dones[i];
+		}
+	}
+
+	free(observations);
+	chip8_env_destroy(env);
+
+	return true;
+}
+
+int main(void) {
+	uint32_t const seeds[INSTANCES] = {0, 1, 2, 3};
+	float rewards[EPISODES][INSTANCES];
+	float again[EPISODES][INSTANCES];
+	bool allDone;
+	bool allDoneAgain;
+
+	if (!runEpisodes(seeds, rewards, &allDone) || !runEpisodes(seeds, again, &allDoneAgain)) {
+		return 1;
+	}
+
+	check(allDone && allDoneAgain, "every step ends an episode");
+	check(memcmp(rewards, again, sizeof(rewards)) == 0, "the same seeds replay the same episodes");
+
+	// Episodes must not reuse another instance's or episode's seed
+	bool distinct = true;
+	for (int a = 0; a < EPISODES * INSTANCES; ++a) {
+		for (int b = a + 1; b < EPISODES * INSTANCES; ++b) {
+			distinct = distinct && rewards[a / INSTANCES][a % INSTANCES] != rewards[b / INSTANCES][b % INSTANCES];
+		}
+	}
+	check(distinct, "every instance and episode draws different numbers");
+
+	return failures > 0 ? 1 : 0;
+}
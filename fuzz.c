@@ -0,0 +1,493 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#include "chip8.h"
+
+#define START_ADDRESS 0x200
+#define MAX_ROM_SIZE (4096 - START_ADDRESS)
+#define MAX_INPUT_SIZE (2 + MAX_ROM_SIZE + 1024)
+#define MAX_CORPUS 4096
+#define MAX_CRASHES 256
+#define CYCLES_PER_STEP 16
+
+struct testcase {
+	uint8_t* data;
+	size_t size;
+};
+
+static struct chip8* chip;
+static struct chip8 pristine;
+
+static uint8_t virgin[FUZZ_MAP_SIZE];
+static struct testcase corpus[MAX_CORPUS];
+static int corpusCount = 0;
+
+static uint32_t crashes[MAX_CRASHES];
+static int crashCount = 0;
+// pc of the instruction the oracle flagged in the last crashing execution
+static uint16_t crashPc;
+
+static bool useSchedule = false;
+static long maxCycles = 10000;
+static const char* crashDir = ".";
+static uint64_t rngState = 0x9E3779B97F4A7C15ull;
+
+static uint64_t rng() {
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 7;
+	rngState ^= rngState << 17;
+	return rngState;
+}
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Snapshot of a freshly initialized instance; every execution starts from a copy of it
+static void makePristine() {
+	chip = chip8_init();
+	if (chip == NULL) {
+		exit(1);
+	}
+	// Fixed Cxkk seed so crashes replay the same way in another process
+	chip8_seed(chip, 1);
+	memcpy(&pristine, chip, sizeof(struct chip8));
+}
+
+// Independent oracle for the next instruction: any violation it predicts must be raised as a fault by the core
+static const char* checkInvariants(struct chip8* chip) {
+	uint16_t opcode = chip->memory[chip->pc & 0xFFFu] << 8 | chip->memory[(chip->pc + 1) & 0xFFFu];
+	uint8_t x = (opcode & 0x0F00u) >> 8u;
+
+	// The fetch itself, after a jump, skip or plain fall-through to the end of memory
+	if (chip->pc > sizeof(chip->memory) - 2) {
+		return "undetected-fetch-out-of-range";
+	}
+
+	switch (opcode & 0xF000u) {
+		case 0x0000:
+			// The decoder only looks at the low nibble, so 0nnE returns too
+			if ((opcode & 0x000Fu) == 0x000E && chip->sp == 0) {
+				return "undetected-stack-underflow";
+			}
+			break;
+		case 0x2000:
+			if (chip->sp >= 16) {
+				return "undetected-stack-overflow";
+			}
+			break;
+		case 0xD000:
+			if (chip->index + (opcode & 0x000Fu) > sizeof(chip->memory)) {
+				return "undetected-sprite-read-out-of-range";
+			}
+			break;
+		case 0xF000:
+			if ((opcode & 0x00FFu) == 0x33 && chip->index + 3 > sizeof(chip->memory)) {
+				return "undetected-bcd-write-out-of-range";
+			}
+			if (((opcode & 0x00FFu) == 0x55 || (opcode & 0x00FFu) == 0x65) && chip->index + x + 1 > sizeof(chip->memory)) {
+				return "undetected-register-dump-out-of-range";
+			}
+			break;
+	}
+
+	return NULL;
+}
+
+// Runs one input from the pristine snapshot. Returns the crash reason, or NULL.
+static const char* execute(const uint8_t* data, size_t size) {
+	const uint8_t* rom = data;
+	size_t romSize = size;
+	const uint8_t* schedule = NULL;
+	size_t scheduleSteps = 0;
+
+	// Schedule mode: [rom length, 2 bytes BE][rom][keypad bitmask, 2 bytes BE, per step]
+	if (useSchedule) {
+		if (size < 2) {
+			return NULL;
+		}
+		romSize = data[0] << 8 | data[1];
+		if (romSize > size - 2) {
+			romSize = size - 2;
+		}
+		rom = data + 2;
+		schedule = rom + romSize;
+		scheduleSteps = (size - 2 - romSize) / 2;
+	}
+
+	if (romSize > MAX_ROM_SIZE) {
+		romSize = MAX_ROM_SIZE;
+	}
+
+	memcpy(chip, &pristine, sizeof(struct chip8));
+	memcpy(chip->memory + START_ADDRESS, rom, romSize);
+
+	memset(fuzzCoverage, 0, sizeof(fuzzCoverage));
+	fuzzPrevPc = 0;
+
+	for (long i = 0; i < maxCycles; ++i) {
+		if (scheduleSteps > 0 && i % CYCLES_PER_STEP == 0) {
+			size_t step = (i / CYCLES_PER_STEP) % scheduleSteps;
+			uint16_t mask = schedule[2 * step] << 8 | schedule[2 * step + 1];
+
+			for (int key = 0; key < 16; ++key) {
+				chip->keypad[key] = (mask >> key) & 1u;
+			}
+		}
+
+		uint16_t pc = chip->pc;
+		const char* reason = checkInvariants(chip);
+
+		chip8_cycle(chip);
+
+		// Faults are an expected ROM error, not a crash
+		if (chip->events & CHIP8_EVENT(CHIP8_FAULT)) {
+			return NULL;
+		}
+		if (reason != NULL) {
+			crashPc = pc;
+			return reason;
+		}
+	}
+
+	return NULL;
+}
+
+// Bucketed hit counts, so loops that run a different number of times count as new behaviour
+static uint8_t bucket(uint8_t hits) {
+	if (hits == 0) return 0;
+	if (hits <= 3) return hits;
+	if (hits <= 7) return 4;
+	if (hits <= 15) return 8;
+	if (hits <= 31) return 16;
+	if (hits <= 127) return 32;
+	return 128;
+}
+
+static bool hasNewCoverage() {
+	bool found = false;
+
+	for (int i = 0; i < FUZZ_MAP_SIZE; ++i) {
+		uint8_t bits = bucket(fuzzCoverage[i]);
+
+		if (bits & ~virgin[i]) {
+			virgin[i] |= bits;
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+static int edgeCount() {
+	int edges = 0;
+
+	for (int i = 0; i < FUZZ_MAP_SIZE; ++i) {
+		if (virgin[i]) {
+			++edges;
+		}
+	}
+
+	return edges;
+}
+
+static void addToCorpus(const uint8_t* data, size_t size) {
+	if (corpusCount == MAX_CORPUS) {
+		return;
+	}
+
+	corpus[corpusCount].data = (uint8_t*)malloc(size ? size : 1);
+	if (corpus[corpusCount].data == NULL) {
+		printf("Error: Failed to allocate corpus entry.\n");
+		exit(1);
+	}
+
+	memcpy(corpus[corpusCount].data, data, size);
+	corpus[corpusCount].size = size;
+	++corpusCount;
+}
+
+static void saveCrash(const char* reason, const uint8_t* data, size_t size) {
+	// Deduplicate by reason and faulting pc
+	uint32_t key = crashPc;
+	for (const char* c = reason; *c; ++c) {
+		key = (key ^ (uint8_t)*c) * 16777619u;
+	}
+
+	for (int i = 0; i < crashCount; ++i) {
+		if (crashes[i] == key) {
+			return;
+		}
+	}
+	if (crashCount < MAX_CRASHES) {
+		crashes[crashCount++] = key;
+	}
+
+	char path[512];
+	snprintf(path, sizeof(path), "%s/crash-%s-%03X", crashDir, reason, crashPc);
+
+	FILE* out = fopen(path, "wb");
+	if (out == NULL) {
+		printf("Error: Failed to write %s\n", path);
+		return;
+	}
+	fwrite(data, 1, size, out);
+	fclose(out);
+
+	printf("CRASH: %s at pc %03X -> %s\n", reason, crashPc, path);
+}
+
+static size_t readFile(const char* path, uint8_t* buffer, size_t capacity) {
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) {
+		return 0;
+	}
+
+	size_t size = fread(buffer, 1, capacity, file);
+	fclose(file);
+
+	return size;
+}
+
+static void loadSeeds(const char* dirPath) {
+	DIR* dir = opendir(dirPath);
+	if (dir == NULL) {
+		printf("Error: Failed to open corpus directory %s\n", dirPath);
+		exit(1);
+	}
+
+	uint8_t buffer[MAX_INPUT_SIZE];
+	struct dirent* entry;
+
+	while ((entry = readdir(dir)) != NULL) {
+		if (entry->d_name[0] == '.') {
+			continue;
+		}
+
+		char path[512];
+		snprintf(path, sizeof(path), "%s/%s", dirPath, entry->d_name);
+
+		size_t size = readFile(path, buffer, sizeof(buffer));
+		if (size == 0) {
+			continue;
+		}
+
+		const char* reason = execute(buffer, size);
+		if (reason != NULL) {
+			saveCrash(reason, buffer, size);
+		}
+		else if (hasNewCoverage()) {
+			addToCorpus(buffer, size);
+		}
+	}
+
+	closedir(dir);
+}
+
+static size_t mutate(uint8_t* data, size_t size) {
+	int rounds = 1 + rng() % 8;
+
+	for (int r = 0; r < rounds; ++r) {
+		switch (rng() % 7) {
+			// Flip a bit
+			case 0:
+				if (size > 0) {
+					data[rng() % size] ^= 1u << (rng() % 8);
+				}
+				break;
+			// Random byte
+			case 1:
+				if (size > 0) {
+					data[rng() % size] = rng();
+				}
+				break;
+			// Random opcode at an instruction boundary
+			case 2:
+				if (size >= 2) {
+					size_t pos = (rng() % (size / 2)) * 2;
+					data[pos] = rng();
+					data[pos + 1] = rng();
+				}
+				break;
+			// Insert an instruction
+			case 3:
+				if (size + 2 <= MAX_INPUT_SIZE) {
+					size_t pos = size ? rng() % size : 0;
+					memmove(data + pos + 2, data + pos, size - pos);
+					data[pos] = rng();
+					data[pos + 1] = rng();
+					size += 2;
+				}
+				break;
+			// Delete an instruction
+			case 4:
+				if (size > 2) {
+					size_t pos = rng() % (size - 2);
+					memmove(data + pos, data + pos + 2, size - pos - 2);
+					size -= 2;
+				}
+				break;
+			// Duplicate a chunk inside the input
+			case 5:
+				if (size >= 4) {
+					size_t len = 1 + rng() % (size / 2);
+					size_t from = rng() % (size - len + 1);
+					size_t to = rng() % (size - len + 1);
+					memmove(data + to, data + from, len);
+				}
+				break;
+			// Splice with another corpus entry
+			case 6:
+				if (corpusCount > 1 && size > 0) {
+					struct testcase* other = &corpus[rng() % corpusCount];
+					size_t cut = rng() % size;
+					size_t tail = other->size > cut ? other->size - cut : 0;
+					if (cut + tail > MAX_INPUT_SIZE) {
+						tail = MAX_INPUT_SIZE - cut;
+					}
+					memcpy(data + cut, other->data + cut, tail);
+					size = cut + tail > size ? cut + tail : size;
+				}
+				break;
+		}
+	}
+
+	return size;
+}
+
+static void fuzz(double duration) {
+	uint8_t buffer[MAX_INPUT_SIZE];
+	uint64_t execs = 0;
+	uint64_t lastExecs = 0;
+	double start = now();
+	double lastReport = start;
+
+	while (duration <= 0 || now() - start < duration) {
+		struct testcase* parent = &corpus[rng() % corpusCount];
+		memcpy(buffer, parent->data, parent->size);
+
+		size_t size = mutate(buffer, parent->size);
+
+		const char* reason = execute(buffer, size);
+		++execs;
+
+		if (reason != NULL) {
+			saveCrash(reason, buffer, size);
+		}
+		else if (hasNewCoverage()) {
+			addToCorpus(buffer, size);
+		}
+
+		if ((execs & 0xFF) == 0) {
+			double t = now();
+			if (t - lastReport >= 1.0) {
+				printf("#%llu  exec/s: %.0f  corpus: %d  edges: %d  crashes: %d\n",
+					(unsigned long long)execs, (execs - lastExecs) / (t - lastReport),
+					corpusCount, edgeCount(), crashCount);
+				lastReport = t;
+				lastExecs = execs;
+			}
+		}
+	}
+
+	double elapsed = now() - start;
+	printf("Done: %llu execs in %.1fs (%.0f exec/s), corpus: %d, edges: %d, crashes: %d\n",
+		(unsigned long long)execs, elapsed, execs / elapsed, corpusCount, edgeCount(), crashCount);
+}
+
+#ifdef CHIP8_LIBFUZZER
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+	if (chip == NULL) {
+		makePristine();
+	}
+
+	if (execute(data, size) != NULL) {
+		abort();
+	}
+
+	return 0;
+}
+
+#else
+
+int main(int argc, char* argv[]) {
+	double duration = 0;
+	bool replay = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "sn:t:o:r")) != -1) {
+		switch (opt) {
+			case 's':
+				useSchedule = true;
+				break;
+			case 'n':
+				maxCycles = atol(optarg);
+				break;
+			case 't':
+				duration = atof(optarg);
+				break;
+			case 'o':
+				crashDir = optarg;
+				break;
+			case 'r':
+				replay = true;
+				break;
+			default:
+				printf("Usage: %s [-s] [-n <Cycles>] [-t <Seconds>] [-o <CrashDir>] [<CorpusDir>]\n", argv[0]);
+				printf("       %s [-s] [-n <Cycles>] -r <Input>...\n", argv[0]);
+				exit(1);
+		}
+	}
+
+	makePristine();
+
+	if (replay) {
+		uint8_t buffer[MAX_INPUT_SIZE];
+
+		for (int i = optind; i < argc; ++i) {
+			size_t size = readFile(argv[i], buffer, sizeof(buffer));
+			const char* reason = execute(buffer, size);
+
+			printf("%s: %s", argv[i], reason ? reason : "ok");
+			if (reason) {
+				printf(" at pc %03X", crashPc);
+			}
+			printf("\n");
+		}
+	}
+	else {
+		rngState ^= (uint64_t)time(NULL);
+
+		if (optind < argc) {
+			loadSeeds(argv[optind]);
+		}
+
+		// Always keep a trivial seed so there is something to mutate
+		if (corpusCount == 0) {
+			uint8_t seed[4] = { 0x00, 0x02, 0x12, 0x00 };
+			if (useSchedule) {
+				addToCorpus(seed, sizeof(seed));
+			}
+			else {
+				addToCorpus(seed + 2, 2);
+			}
+			execute(corpus[0].data, corpus[0].size);
+			hasNewCoverage();
+		}
+
+		fuzz(duration);
+	}
+
+	chip8_destroy(chip);
+
+	return 0;
+}
+
+#endif
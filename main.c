@@ -1,46 +1,176 @@
+#include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
 #include <SDL2/SDL.h>
 
 #include "chip8.h"
+#include "multimedia.h"
+#include "emulator.h"
+#include "savestate.h"
+#include "metrics.h"
+
+#define DEFAULT_TURBO_SPEED 4
+#define STATS_PERIOD_MS 1000
+
+static void usage(char const* program) {
+    printf("Usage: %s <Scale> <Delay> <ROM> [none|scale2x|scale3x|crt] [<Turbo>|max]\n", program);
+    exit(1);
+}
+
+// "max" runs uncapped, otherwise a multiplier above 1 such as "8" or "8x"; anything else is rejected
+static uint32_t parseTurboSpeed(char const* program, char const* arg) {
+    if (strcmp(arg, "max") == 0) {
+        return TURBO_UNCAPPED;
+    }
+
+    char* end;
+    errno = 0;
+    long speed = strtol(arg, &end, 10);
+    if (*end == 'x') {
+        ++end;
+    }
+
+    if (end == arg || *end != '\0' || errno != 0 || speed <= 1 || speed > UINT32_MAX) {
+        printf("Error: Invalid turbo speed %s\n", arg);
+        usage(program);
+    }
+
+    return (uint32_t)speed;
+}
+
+// <ROM without extension>-<n>.c8s, with the first n that isn't taken yet
+static void nextSavePath(char* path, size_t size, char const* rom) {
+    char const* extension = strrchr(rom, '.');
+    int baseLength = extension != NULL && strchr(extension, '/') == NULL ? (int)(extension - rom) : (int)strlen(rom);
+
+    for (unsigned int n = 1; ; ++n) {
+        snprintf(path, size, "%.*s-%u.c8s", baseLength, rom, n);
+
+        if (access(path, F_OK) != 0) {
+            return;
+        }
+    }
+}
 
 int main(int argc, char* argv[]) {
-    if (argc != 4) {
-        printf("Usage: %s <Scale> <Delay> <ROM>\n", argv[0]);
-		exit(1);
+    if (argc < 4 || argc > 6) {
+        usage(argv[0]);
 	}
 
     int videoScale = atoi(argv[1]);
-    int cycleDelay = atoi(argv[2]);
+    // "vip" instead of a delay selects the COSMAC VIP timing model
+    bool vipTiming = strcmp(argv[2], "vip") == 0;
+    int cycleDelay = vipTiming ? 0 : atoi(argv[2]);
     char const* rom = argv[3];
+    enum scaleFilter filter = SCALE_NONE;
+    if (argc >= 5 && !parseScaleFilter(argv[4], &filter)) {
+        printf("Error: Invalid filter %s\n", argv[4]);
+        usage(argv[0]);
+    }
+    // Giving a turbo speed starts in fast-forward, Tab toggles it either way
+    uint32_t turboSpeed = argc == 6 ? parseTurboSpeed(argv[0], argv[5]) : DEFAULT_TURBO_SPEED;
 
     int video_width = 64;
     int video_height = 32;
     
-    struct MultimediaLayer* mult = makeMultimediaLayer("CHIP-8", video_width * videoScale, video_height * videoScale, video_width, video_height);
-    struct chip8* chip8 = init();
-    load(chip8, rom);
+    struct MultimediaLayer* mult = makeMultimediaLayer("CHIP-8", video_width * videoScale, video_height * videoScale, video_width, video_height, filter);
+    mult->turbo = argc == 6;
+    struct chip8* chip8 = chip8_init();
+    if (chip8 == NULL) {
+        exit(1);
+    }
+
+    // A save state instead of a ROM warm-starts from that checkpoint
+    size_t romLength = strlen(rom);
+    if (romLength > 4 && strcmp(rom + romLength - 4, ".c8s") == 0) {
+        if (!chip8_load_state(chip8, rom)) {
+            exit(1);
+        }
+    }
+    else {
+        if (!chip8_load(chip8, rom)) {
+            exit(1);
+        }
+
+        // The core always resets to the same seed, games should still vary between runs
+        chip8_seed(chip8, (uint32_t)time(NULL));
+    }
 
     int videoPitch = sizeof(chip8->video[0]) * video_width;
 
-    clock_t lastCycleTime = clock();
+    // The core runs on its own thread; this one only polls input and presents
+    struct emulator* emu = startEmulator(chip8, cycleDelay, vipTiming);
+
+    // Live counters are rewritten to this file for whoever wants to watch a running instance
+    char const* statsPath = getenv("CHIP8_STATS");
+    if (statsPath != NULL) {
+        startMetrics(statsPath, STATS_PERIOD_MS);
+    }
+
+    uint8_t keys[16] = {0};
+    uint8_t sentKeys[16] = {0};
     bool run = true;
+    bool turbo = false;
+    uint64_t lastPresent = 0;
 
     while(run) {
-        run = processInput(mult, chip8->keypad);
+        uint64_t inputStart = metricsNow();
+        run = processInput(mult, keys) && !emulatorFaulted(emu);
+        metricsAdd(&metrics.render.inputNs, metricsNow() - inputStart);
 
-        clock_t currentTime = clock();
-        float dt = (float)(currentTime - lastCycleTime) / CLOCKS_PER_SEC;
+        if (mult->turbo != turbo) {
+            turbo = mult->turbo;
+            setEmulatorSpeed(emu, turbo ? turboSpeed : 1);
+        }
 
-        if(dt > cycleDelay) {
-            lastCycleTime = currentTime ;
-            cycle(chip8);
-            updateMultimediaLayer(mult, chip8->video, videoPitch);
+        if (mult->saveRequested) {
+            char path[256];
+            nextSavePath(path, sizeof(path), rom);
+            mult->saveRequested = !requestSave(emu, path);
         }
+
+        for (int key = 0; key < 16; ++key) {
+            if (keys[key] != sentKeys[key] && pushKeyEvent(emu, key, keys[key])) {
+                sentKeys[key] = keys[key];
+            }
+        }
+
+        uint32_t const* frame = latestFrame(emu);
+        if (frame != NULL) {
+            uint64_t presentStart = metricsNow();
+            updateMultimediaLayer(mult, frame, videoPitch);
+            uint64_t presentEnd = metricsNow();
+
+            metricsRecord(&metrics.render.presentTime, presentEnd - presentStart);
+            if (lastPresent != 0) {
+                metricsRecord(&metrics.render.frameInterval, presentEnd - lastPresent);
+            }
+            metricsAdd(&metrics.render.framesPresented, 1);
+            lastPresent = presentEnd;
+        }
+        else {
+            SDL_Delay(1);
+        }
+    }
+
+    bool faulted = emulatorFaulted(emu);
+    stopEmulator(emu);
+    stopMetrics();
+
+    // The emulation thread has stopped, so the fault details can be read safely
+    if (faulted) {
+        printf("Error: %s.\n PC - %03X OPCODE - %04X\n", chip8_fault_name(chip8_fault(chip8)), chip8->faultPc, chip8->faultOpcode);
     }
 
-    free(chip8);
+#ifdef CHIP8_PROFILE
+    writeMemoryProfile(stdout);
+#endif
+    chip8_destroy(chip8);
     destroyMultimediaLayer(mult);
 
-    return 0;
+    return faulted ? 1 : 0;
 }
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <SDL2/SDL.h>
+
+#include "metrics.h"
+
+struct metrics metrics;
+
+static const char* statsPath;
+static unsigned int statsPeriod;
+static atomic_bool statsRunning;
+static SDL_Thread* statsThread;
+static uint64_t startTime;
+
+uint64_t metricsNow(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static uint64_t readCounter(_Atomic uint64_t* counter) {
+	return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+// Prometheus text format, so the file can be scraped by a textfile collector as well as read by hand
+static void writeHistogram(FILE* out, const char* name, struct histogram* histogram) {
+	uint64_t count = 0;
+
+	fprintf(out, "# TYPE %s_us histogram\n", name);
+	for (int i = 0; i < METRICS_BUCKETS; ++i) {
+		count += readCounter(&histogram->buckets[i]);
+
+		if (i < METRICS_BUCKETS - 1) {
+			fprintf(out, "%s_us_bucket{le=\"%llu\"} %llu\n", name, 1ull << i, (unsigned long long)count);
+		}
+		else {
+			fprintf(out, "%s_us_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)count);
+		}
+	}
+	fprintf(out, "%s_us_sum %.1f\n", name, readCounter(&histogram->sumNs) / 1e3);
+	fprintf(out, "%s_us_count %llu\n", name, (unsigned long long)count);
+}
+
+static void writeCounter(FILE* out, const char* name, uint64_t value) {
+	fprintf(out, "# TYPE %s counter\n%s %llu\n", name, name, (unsigned long long)value);
+}
+
+static void writeGauge(FILE* out, const char* name, double value) {
+	fprintf(out, "# TYPE %s gauge\n%s %.1f\n", name, name, value);
+}
+
+static bool writeStats(uint64_t* lastTime, uint64_t* lastInstructions, uint64_t* lastPresented) {
+	char tempPath[512];
+	snprintf(tempPath, sizeof(tempPath), "%s.tmp", statsPath);
+
+	FILE* out = fopen(tempPath, "w");
+	if (out == NULL) {
+		printf("Error: Failed to write %s\n", tempPath);
+		return false;
+	}
+
+	uint64_t now = metricsNow();
+	uint64_t instructions = readCounter(&metrics.emulation.instructions);
+	uint64_t presented = readCounter(&metrics.render.framesPresented);
+	double interval = (now - *lastTime) / 1e9;
+
+	writeGauge(out, "chip8_uptime_seconds", (now - startTime) / 1e9);
+	writeGauge(out, "chip8_instructions_per_second", (instructions - *lastInstructions) / interval);
+	writeGauge(out, "chip8_frames_per_second", (presented - *lastPresented) / interval);
+
+	writeCounter(out, "chip8_instructions_total", instructions);
+	writeCounter(out, "chip8_emulation_busy_us_total", readCounter(&metrics.emulation.busyNs) / 1000);
+	writeCounter(out, "chip8_frames_published_total", readCounter(&metrics.emulation.framesPublished));
+	writeCounter(out, "chip8_frames_presented_total", presented);
+	writeCounter(out, "chip8_frames_skipped_total", readCounter(&metrics.emulation.framesSkipped));
+	writeCounter(out, "chip8_frames_dropped_total", readCounter(&metrics.emulation.framesDropped));
+	writeCounter(out, "chip8_input_us_total", readCounter(&metrics.render.inputNs) / 1000);
+	writeCounter(out, "chip8_audio_blocked_us_total", readCounter(&metrics.emulation.audioBlockedNs) / 1000);
+	writeCounter(out, "chip8_audio_callbacks_total", readCounter(&metrics.audio.callbacks));
+	writeCounter(out, "chip8_audio_underruns_total", readCounter(&metrics.audio.underruns));
+
+	writeHistogram(out, "chip8_frame_interval", &metrics.render.frameInterval);
+	writeHistogram(out, "chip8_present_time", &metrics.render.presentTime);
+
+	fclose(out);
+
+	*lastTime = now;
+	*lastInstructions = instructions;
+	*lastPresented = presented;
+
+	// Readers only ever see a complete file
+	return rename(tempPath, statsPath) == 0;
+}
+
+static int metricsThread(void* data) {
+	(void)data;
+
+	uint64_t lastTime = startTime;
+	uint64_t lastInstructions = 0;
+	uint64_t lastPresented = 0;
+	uint64_t next = startTime;
+
+	while (atomic_load_explicit(&statsRunning, memory_order_relaxed)) {
+		next += (uint64_t)statsPeriod * 1000000ull;
+
+		// Wake up often enough to stop promptly
+		while (metricsNow() < next && atomic_load_explicit(&statsRunning, memory_order_relaxed)) {
+			SDL_Delay(10);
+		}
+
+		if (!writeStats(&lastTime, &lastInstructions, &lastPresented)) {
+			break;
+		}
+	}
+
+	return 0;
+}
+
+// Rewrites the stats file at path every periodMs milliseconds from a thread of its own
+bool startMetrics(const char* path, unsigned int periodMs) {
+	statsPath = path;
+	statsPeriod = periodMs;
+	startTime = metricsNow();
+	atomic_init(&statsRunning, true);
+
+	statsThread = SDL_CreateThread(metricsThread, "metrics", NULL);
+	if (statsThread == NULL) {
+		printf("Error: Wasn't able to create metrics thread.\n");
+		return false;
+	}
+
+	return true;
+}
+
+void stopMetrics(void) {
+	if (statsThread == NULL) {
+		return;
+	}
+
+	atomic_store(&statsRunning, false);
+	SDL_WaitThread(statsThread, NULL);
+	statsThread = NULL;
+}
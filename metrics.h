@@ -0,0 +1,76 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "chip8.h"
+
+// Histogram buckets are powers of two in microseconds, the last one is open-ended
+#define METRICS_BUCKETS 16
+
+struct histogram {
+	_Atomic uint64_t buckets[METRICS_BUCKETS];
+	_Atomic uint64_t sumNs;
+};
+
+// Every group is written by a single thread only, so updates are a relaxed load and
+// store with no locks or read-modify-writes, and each group sits on its own cache line.
+
+// Emulation thread
+struct emulationMetrics {
+	_Atomic uint64_t instructions;
+	_Atomic uint64_t busyNs;
+	_Atomic uint64_t framesPublished;
+	_Atomic uint64_t framesSkipped;   // replaced by a newer frame before publishing, while fast-forwarding
+	_Atomic uint64_t framesDropped;   // published but replaced before the render thread took them
+	_Atomic uint64_t audioBlockedNs;
+	_Atomic uint64_t audioResumed;    // time the buzzer was last unpaused, in ns
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+// Render thread
+struct renderMetrics {
+	_Atomic uint64_t framesPresented;
+	_Atomic uint64_t inputNs;
+	struct histogram frameInterval;
+	struct histogram presentTime;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+// Audio callback
+struct audioMetrics {
+	_Atomic uint64_t callbacks;
+	_Atomic uint64_t underruns;
+	_Atomic uint64_t lastCallback;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+struct metrics {
+	struct emulationMetrics emulation;
+	struct renderMetrics render;
+	struct audioMetrics audio;
+};
+
+extern struct metrics metrics;
+
+static inline void metricsAdd(_Atomic uint64_t* counter, uint64_t amount) {
+	atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+static inline void metricsSet(_Atomic uint64_t* counter, uint64_t value) {
+	atomic_store_explicit(counter, value, memory_order_relaxed);
+}
+
+static inline void metricsRecord(struct histogram* histogram, uint64_t ns) {
+	// Bucket i counts values <= 2^i us, Prometheus' le; rounding up keeps 1.5 us out of le="1"
+	uint64_t us = (ns + 999) / 1000;
+	int bucket = us <= 1 ? 0 : 64 - __builtin_clzll(us - 1);
+
+	metricsAdd(&histogram->buckets[bucket < METRICS_BUCKETS ? bucket : METRICS_BUCKETS - 1], 1);
+	metricsAdd(&histogram->sumNs, ns);
+}
+
+uint64_t metricsNow(void);
+bool startMetrics(const char*, unsigned int);
+void stopMetrics(void);
+
+#endif
@@ -0,0 +1,234 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <SDL2/SDL.h>
+
+#include "multimedia.h"
+#include "metrics.h"
+
+void audio_callback(void *user_data, Uint8 *raw_buffer, int bytes) {
+	int amplitude = 28000;
+	int sample_rate = 8820;
+
+    Sint16 *buffer = (Sint16*)raw_buffer;
+    int length = bytes / 2; // 2 bytes per sample for AUDIO_S16SYS
+    int sample_nr = *(int*)user_data;
+
+    // A callback that comes much later than the previous buffer ran out means the device starved,
+    // unless the buzzer was paused in between
+    uint64_t now = metricsNow();
+    uint64_t last = atomic_load_explicit(&metrics.audio.lastCallback, memory_order_relaxed);
+    uint64_t bufferNs = 1000000000ull * length / sample_rate;
+    if (last > atomic_load_explicit(&metrics.emulation.audioResumed, memory_order_relaxed) && now - last > bufferNs * 3 / 2) {
+        metricsAdd(&metrics.audio.underruns, 1);
+    }
+    metricsSet(&metrics.audio.lastCallback, now);
+    metricsAdd(&metrics.audio.callbacks, 1);
+
+    for(int i = 0; i < length; i++, sample_nr++) {
+        double time = (double)sample_nr / (double)sample_rate;
+        buffer[i] = (Sint16)(amplitude * sin(2.0f * M_PI * 441.0f * time)); // render 441 HZ sine wave
+    }
+}
+
+struct MultimediaLayer* makeMultimediaLayer(char const* title, int windowWidth, int windowHeight, int textureWidth, int textureHeight, enum scaleFilter filter) {
+    struct MultimediaLayer* mult = (struct MultimediaLayer*)malloc(sizeof(struct MultimediaLayer));
+
+    if(mult == NULL) {
+        printf("Error: Wasn't able to create multimedia layer.\n");
+        exit(1);
+    }
+
+	SDL_Init(SDL_INIT_VIDEO);
+	mult->window = SDL_CreateWindow(title, 0, 0, windowWidth, windowHeight, SDL_WINDOW_SHOWN);
+	mult->renderer = SDL_CreateRenderer(mult->window, -1, SDL_RENDERER_ACCELERATED);
+	// Filters scale on the CPU straight into a larger streaming texture
+	mult->filter = filter;
+	mult->turbo = false;
+	mult->saveRequested = false;
+	mult->texture = SDL_CreateTexture(mult->renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING,
+		textureWidth * scaleFactor(filter), textureHeight * scaleFactor(filter));
+
+	//Setting up audio
+    static int sample_nr = 0;
+
+    SDL_AudioSpec want;
+    want.freq = 8820; // number of samples per second
+    want.format = AUDIO_S16SYS; // sample type (here: signed short i.e. 16 bit)
+    want.channels = 1; // only one channel
+    want.samples = 2048; // buffer-size 2048
+    want.callback = audio_callback; // function SDL calls periodically to refill the buffer
+    want.userdata = &sample_nr; // counter, keeping track of current sample number
+
+    SDL_AudioSpec have;
+    if(SDL_OpenAudio(&want, &have) != 0) SDL_LogError(SDL_LOG_CATEGORY_AUDIO, "Failed to open audio: %s", SDL_GetError());
+    if(want.format != have.format) SDL_LogError(SDL_LOG_CATEGORY_AUDIO, "Failed to get the desired AudioSpec");
+
+    return mult;
+}
+
+void destroyMultimediaLayer(struct MultimediaLayer* mult) {
+    SDL_DestroyTexture(mult->texture);
+	SDL_DestroyRenderer(mult->renderer);
+	SDL_DestroyWindow(mult->window);
+	SDL_CloseAudio();
+	SDL_Quit();
+
+    free(mult);
+}
+
+bool processInput(struct MultimediaLayer* mult, uint8_t* keys) {
+    bool run = true;
+
+    SDL_Event event;
+
+	while (SDL_PollEvent(&event)) {
+		switch (event.type) {
+			case SDL_QUIT:
+				run = false;
+				break;
+			case SDL_KEYDOWN:
+				switch (event.key.keysym.sym) {
+					case SDLK_ESCAPE:
+						run = false;
+						break;
+					case SDLK_TAB:
+						if (!event.key.repeat) {
+							mult->turbo = !mult->turbo;
+						}
+						break;
+					case SDLK_F5:
+						// One save per press, not one per autorepeat
+						if (!event.key.repeat) {
+							mult->saveRequested = true;
+						}
+						break;
+					case SDLK_1:
+						keys[1] = 1;
+						break;
+					case SDLK_2:
+						keys[2] = 1;
+						break;
+					case SDLK_3:
+						keys[3] = 1;
+						break;
+					case SDLK_4:
+						keys[0xC] = 1;
+						break;
+					case SDLK_q:
+						keys[4] = 1;
+						break;
+					case SDLK_w:
+						keys[5] = 1;
+						break;
+					case SDLK_e:
+						keys[6] = 1;
+						break;
+					case SDLK_r:
+						keys[0xD] = 1;
+						break;
+					case SDLK_a:
+						keys[7] = 1;
+						break;
+					case SDLK_s:
+						keys[8] = 1;
+						break;
+					case SDLK_d:
+						keys[9] = 1;
+						break;
+					case SDLK_f:
+						keys[0xE] = 1;
+						break;
+					case SDLK_z:
+						keys[0xA] = 1;
+						break;
+					case SDLK_x:
+						keys[0] = 1;
+						break;
+					case SDLK_c:
+						keys[0xB] = 1;
+						break;
+					case SDLK_v:
+						keys[0xF] = 1;
+						break;
+				}
+				break;
+			case SDL_KEYUP:
+				switch (event.key.keysym.sym) {
+					case SDLK_ESCAPE:
+						run = false;
+						break;
+					case SDLK_1:
+						keys[1] = 0;
+						break;
+					case SDLK_2:
+						keys[2] = 0;
+						break;
+					case SDLK_3:
+						keys[3] = 0;
+						break;
+					case SDLK_4:
+						keys[0xC] = 0;
+						break;
+					case SDLK_q:
+						keys[4] = 0;
+						break;
+					case SDLK_w:
+						keys[5] = 0;
+						break;
+					case SDLK_e:
+						keys[6] = 0;
+						break;
+					case SDLK_r:
+						keys[0xD] = 0;
+						break;
+					case SDLK_a:
+						keys[7] = 0;
+						break;
+					case SDLK_s:
+						keys[8] = 0;
+						break;
+					case SDLK_d:
+						keys[9] = 0;
+						break;
+					case SDLK_f:
+						keys[0xE] = 0;
+						break;
+					case SDLK_z:
+						keys[0xA] = 0;
+						break;
+					case SDLK_x:
+						keys[0] = 0;
+						break;
+					case SDLK_c:
+						keys[0xB] = 0;
+						break;
+					case SDLK_v:
+						keys[0xF] = 0;
+						break;
+				}
+				break;
+		}
+	}
+
+    return run;
+}
+
+void updateMultimediaLayer(struct MultimediaLayer* mult, void const* buffer, int pitch) {
+	if (mult->filter == SCALE_NONE) {
+		SDL_UpdateTexture(mult->texture, NULL, buffer, pitch);
+	}
+	else {
+		void* pixels;
+		int texturePitch;
+
+		if (SDL_LockTexture(mult->texture, NULL, &pixels, &texturePitch) == 0) {
+			scaleFrame(mult->filter, (uint32_t const*)buffer, (uint32_t*)pixels, texturePitch / sizeof(uint32_t));
+			SDL_UnlockTexture(mult->texture);
+		}
+	}
+
+	SDL_RenderClear(mult->renderer);
+	SDL_RenderCopy(mult->renderer, mult->texture, NULL, NULL);
+	SDL_RenderPresent(mult->renderer);
+}
@@ -0,0 +1,26 @@
+#ifndef MULTIMEDIA_H
+#define MULTIMEDIA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+
+#include "scale.h"
+
+struct MultimediaLayer {
+	SDL_Window* window;
+	SDL_Renderer* renderer;
+	SDL_Texture* texture;
+	enum scaleFilter filter;
+	// Toggled by the Tab key
+	bool turbo;
+	// Set by F5, cleared by whoever handles it
+	bool saveRequested;
+};
+
+struct MultimediaLayer* makeMultimediaLayer(char const*, int, int, int, int, enum scaleFilter);
+void destroyMultimediaLayer(struct MultimediaLayer*);
+bool processInput(struct MultimediaLayer*, uint8_t*);
+void updateMultimediaLayer(struct MultimediaLayer*, void const*, int);
+
+#endif
@@ -0,0 +1,105 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "chip8.h"
+
+#define PROFILE_TOP 10
+
+static const uint32_t* sortCounters;
+
+static int compareCounters(const void* a, const void* b) {
+	uint32_t left = sortCounters[*(const uint16_t*)a];
+	uint32_t right = sortCounters[*(const uint16_t*)b];
+
+	return (left < right) - (left > right);
+}
+
+static void writeHottest(FILE* out, const char* title, const uint32_t* counters) {
+	uint16_t order[4096];
+	uint64_t total = 0;
+
+	for (int i = 0; i < 4096; ++i) {
+		order[i] = i;
+		total += counters[i];
+	}
+
+	if (total == 0) {
+		return;
+	}
+
+	sortCounters = counters;
+	qsort(order, 4096, sizeof(order[0]), compareCounters);
+
+	fprintf(out, "\n%s (%llu total)\n", title, (unsigned long long)total);
+
+	for (int i = 0; i < PROFILE_TOP && counters[order[i]] > 0; ++i) {
+		fprintf(out, "  0x%03X  %10u  %5.1f%%\n", order[i], counters[order[i]], 100.0 * counters[order[i]] / total);
+	}
+}
+
+// Code/data/sprite classification of one byte
+static char classify(int address) {
+	const struct memoryProfile* p = &memoryProfile;
+
+	bool code = p->fetches[address] > 0;
+	bool sprite = p->spriteReads[address] > 0;
+	bool data = p->dataReads[address] > 0 || p->writes[address] > 0;
+
+	// Only writes after the byte was executed; code generated before it runs is still safe to cache
+	if (p->smcWrites[address] > 0) return '!';
+	if (code && (sprite || data)) return '*';
+	if (code) return 'C';
+	if (sprite) return 'S';
+	if (data) return 'D';
+
+	return '.';
+}
+
+void writeMemoryProfile(FILE* out) {
+	const struct memoryProfile* p = &memoryProfile;
+	int counts[128] = {0};
+
+	for (int address = 0; address < 4096; ++address) {
+		++counts[(int)classify(address)];
+	}
+
+	fprintf(out, "Memory profile\n");
+	fprintf(out, "  code: %d bytes, sprite: %d bytes, data: %d bytes, shared: %d bytes, overwritten code: %d bytes\n",
+		counts['C'] + counts['*'] + counts['!'], counts['S'], counts['D'], counts['*'], counts['!']);
+	fprintf(out, "  self-modifying writes: %u -- %s\n", p->smcCount,
+		p->smcCount == 0 ? "safe to cache or translate code" : "NOT safe to cache or translate code");
+
+	fprintf(out, "\nMap (. untouched, C code, S sprite, D data, * code also read or written as data, ! code overwritten after it ran)\n");
+	for (int row = 0; row < 4096; row += 64) {
+		char line[65];
+		bool touched = false;
+
+		for (int col = 0; col < 64; ++col) {
+			line[col] = classify(row + col);
+			touched |= line[col] != '.';
+		}
+		line[64] = '\0';
+
+		if (touched) {
+			fprintf(out, "  %03X: %s\n", row, line);
+		}
+	}
+
+	writeHottest(out, "Hottest code (fetches)", p->fetches);
+	writeHottest(out, "Hottest sprite data (Dxyn reads)", p->spriteReads);
+	writeHottest(out, "Hottest data (Fx65 reads)", p->dataReads);
+	writeHottest(out, "Hottest writes (Fx33/Fx55)", p->writes);
+
+	if (p->smcEventCount > 0) {
+		fprintf(out, "\nSelf-modifying writes\n");
+
+		for (uint32_t i = 0; i < p->smcEventCount; ++i) {
+			const struct smcEvent* event = &p->smcEvents[i];
+			fprintf(out, "  pc 0x%03X (%04X) wrote 0x%03X\n", event->pc, event->opcode, event->address);
+		}
+
+		if (p->smcEventCount == PROFILE_MAX_SMC_EVENTS) {
+			fprintf(out, "  ... list truncated\n");
+		}
+	}
+}
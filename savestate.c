@@ -0,0 +1,109 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "savestate.h"
+
+// Word-wise variant of FNV-1a (which hashes bytes), a quarter of the multiplies;
+// the state size is a multiple of the cache line
+static uint32_t checksum(struct chip8 const* chip) {
+	uint32_t const* words = (uint32_t const*)chip;
+	uint32_t hash = 2166136261u;
+
+	for (size_t i = 0; i < sizeof(struct chip8) / sizeof(uint32_t); ++i) {
+		hash = (hash ^ words[i]) * 16777619u;
+	}
+
+	return hash;
+}
+
+bool chip8_save_state(struct chip8 const* chip, const char* path) {
+	struct saveStateHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = SAVESTATE_MAGIC;
+	header.version = SAVESTATE_VERSION;
+	header.stateSize = sizeof(struct chip8);
+	header.checksum = checksum(chip);
+
+	FILE* file = fopen(path, "wb");
+	if (file == NULL) {
+		printf("Error: Failed to create save state %s\n", path);
+		return false;
+	}
+
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(chip, sizeof(struct chip8), 1, file) == 1;
+
+	if (fclose(file) != 0 || !written) {
+		printf("Error: Failed to write save state %s\n", path);
+		return false;
+	}
+
+	return true;
+}
+
+// Maps a save state read-only after checking its header and checksum. Returns NULL if it can't be used.
+struct saveState const* chip8_map_state(const char* path) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		printf("Error: Failed to open save state %s\n", path);
+		return NULL;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size != sizeof(struct saveState)) {
+		printf("Error: %s is not a save state for this build\n", path);
+		close(fd);
+		return NULL;
+	}
+
+	void* mapped = mmap(NULL, sizeof(struct saveState), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (mapped == MAP_FAILED) {
+		printf("Error: Failed to map save state %s\n", path);
+		return NULL;
+	}
+
+	struct saveState const* state = (struct saveState const*)mapped;
+	struct saveStateHeader const* header = &state->header;
+
+	if (header->magic != SAVESTATE_MAGIC || header->version != SAVESTATE_VERSION || header->stateSize != sizeof(struct chip8)) {
+		printf("Error: %s is not a save state for this build\n", path);
+		chip8_unmap_state(state);
+		return NULL;
+	}
+
+	if (header->checksum != checksum(&state->state)) {
+		printf("Error: Save state %s is corrupted\n", path);
+		chip8_unmap_state(state);
+		return NULL;
+	}
+
+	return state;
+}
+
+void chip8_unmap_state(struct saveState const* state) {
+	munmap((void*)state, sizeof(struct saveState));
+}
+
+// Warm start from an already validated mapping
+void chip8_restore_state(struct chip8* chip, struct saveState const* state) {
+	memcpy(chip, &state->state, sizeof(struct chip8));
+	chip->events |= CHIP8_EVENT(CHIP8_DISPLAY);
+}
+
+bool chip8_load_state(struct chip8* chip, const char* path) {
+	struct saveState const* state = chip8_map_state(path);
+	if (state == NULL) {
+		return false;
+	}
+
+	chip8_restore_state(chip, state);
+	chip8_unmap_state(state);
+
+	return true;
+}
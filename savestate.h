@@ -0,0 +1,34 @@
+#ifndef SAVESTATE_H
+#define SAVESTATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "chip8.h"
+
+#define SAVESTATE_MAGIC 0x38504843u // "CHP8"
+// Bump whenever the layout of struct chip8 changes
+#define SAVESTATE_VERSION 4
+
+struct saveStateHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t stateSize;
+	uint32_t checksum;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+// On-disk format: the header followed by the raw instance, in host byte order.
+// The file is mapped as-is and the instance restored with a single memcpy.
+struct saveState {
+	struct saveStateHeader header;
+	struct chip8 state;
+};
+
+bool chip8_save_state(struct chip8 const*, const char*);
+bool chip8_load_state(struct chip8*, const char*);
+
+struct saveState const* chip8_map_state(const char*);
+void chip8_unmap_state(struct saveState const*);
+void chip8_restore_state(struct chip8*, struct saveState const*);
+
+#endif
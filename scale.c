@@ -0,0 +1,176 @@
+#include <string.h>
+
+#include "scale.h"
+
+// The framebuffer only holds on/off pixels, so each row packs into a 64-bit mask
+// and the filter rules run on all 64 pixels of a row at once.
+
+#define WIDTH 64
+#define HEIGHT 32
+
+#define PIXEL_ON 0xFFFFFFFFu
+#define PIXEL_OFF 0x00000000u
+#define SCANLINE_ON 0x9F9F9FFFu
+#define GLOW 0x303030FFu
+
+static void packRows(uint32_t const* video, uint64_t* rows) {
+	for (int y = 0; y < HEIGHT; ++y) {
+		uint64_t mask = 0;
+
+		for (int x = 0; x < WIDTH; ++x) {
+			mask |= (uint64_t)(video[y * WIDTH + x] & 1u) << x;
+		}
+
+		rows[y] = mask;
+	}
+}
+
+// Neighbour masks, replicating the edge pixel like Scale2x does at borders
+static inline uint64_t leftOf(uint64_t row) {
+	return row << 1 | (row & 1u);
+}
+
+static inline uint64_t rightOf(uint64_t row) {
+	return row >> 1 | (row & (1ull << 63));
+}
+
+static inline uint64_t select(uint64_t condition, uint64_t yes, uint64_t no) {
+	return (condition & yes) | (~condition & no);
+}
+
+// Writes the pixels of mask a at even and mask b at odd positions
+static void writeInterleaved2(uint32_t* out, uint64_t a, uint64_t b) {
+	for (int x = 0; x < WIDTH; ++x) {
+		out[2 * x] = -(uint32_t)((a >> x) & 1u);
+		out[2 * x + 1] = -(uint32_t)((b >> x) & 1u);
+	}
+}
+
+static void writeInterleaved3(uint32_t* out, uint64_t a, uint64_t b, uint64_t c) {
+	for (int x = 0; x < WIDTH; ++x) {
+		out[3 * x] = -(uint32_t)((a >> x) & 1u);
+		out[3 * x + 1] = -(uint32_t)((b >> x) & 1u);
+		out[3 * x + 2] = -(uint32_t)((c >> x) & 1u);
+	}
+}
+
+static void scale2x(uint64_t const* rows, uint32_t* out, int pitch) {
+	for (int y = 0; y < HEIGHT; ++y) {
+		uint64_t P = rows[y];
+		uint64_t A = y > 0 ? rows[y - 1] : P;
+		uint64_t D = y < HEIGHT - 1 ? rows[y + 1] : P;
+		uint64_t C = leftOf(P);
+		uint64_t B = rightOf(P);
+
+		uint64_t E0 = select(~(C ^ A) & (C ^ D) & (A ^ B), A, P);
+		uint64_t E1 = select(~(A ^ B) & (A ^ C) & (B ^ D), B, P);
+		uint64_t E2 = select(~(D ^ C) & (D ^ B) & (C ^ A), C, P);
+		uint64_t E3 = select(~(B ^ D) & (B ^ A) & (D ^ C), D, P);
+
+		writeInterleaved2(out + (2 * y) * pitch, E0, E1);
+		writeInterleaved2(out + (2 * y + 1) * pitch, E2, E3);
+	}
+}
+
+static void scale3x(uint64_t const* rows, uint32_t* out, int pitch) {
+	for (int y = 0; y < HEIGHT; ++y) {
+		uint64_t E = rows[y];
+		uint64_t B = y > 0 ? rows[y - 1] : E;
+		uint64_t H = y < HEIGHT - 1 ? rows[y + 1] : E;
+		uint64_t D = leftOf(E);
+		uint64_t F = rightOf(E);
+		uint64_t A = leftOf(B);
+		uint64_t C = rightOf(B);
+		uint64_t G = leftOf(H);
+		uint64_t I = rightOf(H);
+
+		// The four edge conditions every output pixel is built from
+		uint64_t topLeft = ~(D ^ B) & (D ^ H) & (B ^ F);
+		uint64_t topRight = ~(B ^ F) & (B ^ D) & (F ^ H);
+		uint64_t bottomLeft = ~(D ^ H) & (D ^ B) & (H ^ F);
+		uint64_t bottomRight = ~(H ^ F) & (H ^ D) & (F ^ B);
+
+		uint64_t E0 = select(topLeft, D, E);
+		uint64_t E1 = select((topLeft & (E ^ C)) | (topRight & (E ^ A)), B, E);
+		uint64_t E2 = select(topRight, F, E);
+		uint64_t E3 = select((topLeft & (E ^ G)) | (bottomLeft & (E ^ A)), D, E);
+		uint64_t E5 = select((topRight & (E ^ I)) | (bottomRight & (E ^ C)), F, E);
+		uint64_t E6 = select(bottomLeft, D, E);
+		uint64_t E7 = select((bottomLeft & (E ^ I)) | (bottomRight & (E ^ G)), H, E);
+		uint64_t E8 = select(bottomRight, F, E);
+
+		writeInterleaved3(out + (3 * y) * pitch, E0, E1, E2);
+		writeInterleaved3(out + (3 * y + 1) * pitch, E3, E, E5);
+		writeInterleaved3(out + (3 * y + 2) * pitch, E6, E7, E8);
+	}
+}
+
+// 3x3 blocks: two full rows and a dimmed scanline, with a faint glow on off pixels next to lit ones
+static void scaleCrt(uint64_t const* rows, uint32_t* out, int pitch) {
+	for (int y = 0; y < HEIGHT; ++y) {
+		uint64_t P = rows[y];
+		uint64_t glow = (P << 1 | P >> 1) & ~P;
+
+		uint32_t* line = out + (3 * y) * pitch;
+		uint32_t* scanline = out + (3 * y + 2) * pitch;
+
+		for (int x = 0; x < WIDTH; ++x) {
+			uint32_t on = -(uint32_t)((P >> x) & 1u);
+			uint32_t halo = -(uint32_t)((glow >> x) & 1u);
+			uint32_t color = (on & PIXEL_ON) | (halo & GLOW);
+			uint32_t dim = (on & SCANLINE_ON) | (~on & PIXEL_OFF);
+
+			line[3 * x] = line[3 * x + 1] = line[3 * x + 2] = color;
+			scanline[3 * x] = scanline[3 * x + 1] = scanline[3 * x + 2] = dim;
+		}
+
+		memcpy(out + (3 * y + 1) * pitch, line, sizeof(uint32_t) * 3 * WIDTH);
+	}
+}
+
+// Returns false for an unknown filter name
+bool parseScaleFilter(const char* name, enum scaleFilter* filter) {
+	if (strcmp(name, "none") == 0) *filter = SCALE_NONE;
+	else if (strcmp(name, "scale2x") == 0) *filter = SCALE_2X;
+	else if (strcmp(name, "scale3x") == 0) *filter = SCALE_3X;
+	else if (strcmp(name, "crt") == 0) *filter = SCALE_CRT;
+	else return false;
+
+	return true;
+}
+
+int scaleFactor(enum scaleFilter filter) {
+	switch (filter) {
+		case SCALE_2X:
+			return 2;
+		case SCALE_3X:
+		case SCALE_CRT:
+			return 3;
+		default:
+			return 1;
+	}
+}
+
+// Scales a 64x32 framebuffer into out, whose pitch is given in pixels
+void scaleFrame(enum scaleFilter filter, uint32_t const* video, uint32_t* out, int pitch) {
+	uint64_t rows[HEIGHT];
+
+	packRows(video, rows);
+
+	switch (filter) {
+		case SCALE_2X:
+			scale2x(rows, out, pitch);
+			break;
+		case SCALE_3X:
+			scale3x(rows, out, pitch);
+			break;
+		case SCALE_CRT:
+			scaleCrt(rows, out, pitch);
+			break;
+		default:
+			for (int y = 0; y < HEIGHT; ++y) {
+				memcpy(out + y * pitch, video + y * WIDTH, sizeof(uint32_t) * WIDTH);
+			}
+			break;
+	}
+}
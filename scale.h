@@ -0,0 +1,19 @@
+#ifndef SCALE_H
+#define SCALE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// CPU upscaling filters for the 64x32 framebuffer, for hosts without GPU scaling
+enum scaleFilter {
+	SCALE_NONE,
+	SCALE_2X,   // EPX/Scale2x
+	SCALE_3X,   // Scale3x
+	SCALE_CRT,  // 3x with dimmed scanlines and phosphor glow
+};
+
+bool parseScaleFilter(const char*, enum scaleFilter*);
+int scaleFactor(enum scaleFilter);
+void scaleFrame(enum scaleFilter, uint32_t const*, uint32_t*, int);
+
+#endif
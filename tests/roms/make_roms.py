@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+# Assembles the conformance ROMs in this directory: python3 tests/roms/make_roms.py
+#
+# A program is a list of 16-bit opcodes, label names (strings) and (opcode, label)
+# pairs whose label address is ORed into the low 12 bits.
+
+import os
+
+START = 0x200
+
+
+def assemble(program):
+    labels = {}
+    address = START
+    for item in program:
+        if isinstance(item, str):
+            labels[item] = address
+        else:
+            address += 2
+
+    words = []
+    for item in program:
+        if isinstance(item, str):
+            continue
+        if isinstance(item, tuple):
+            opcode, label = item
+            words.append(opcode | labels[label])
+        else:
+            words.append(item)
+
+    return b"".join(bytes([word >> 8, word & 0xFF]) for word in words)
+
+
+def write(name, program):
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)), name)
+    with open(path, "wb") as rom:
+        rom.write(assemble(program))
+
+
+# Font sprites drawn in a grid
+write("font.ch8", [
+    0x6000, 0x6100, 0x6200,
+    "digit",
+    0xF029, 0xD125, 0x7001, 0x7105,
+    0x3008, (0x1000, "row"),
+    0x6100, 0x7206,
+    "row",
+    0x3010, (0x1000, "digit"),
+    "halt",
+    (0x1000, "halt"),
+])
+
+# Draws V5 as three BCD digits at (V6, V7) and moves V6 past them
+DRAW_BCD = [
+    0xA400, 0xF533, 0xF265,
+    0xF029, 0xD675, 0x7605,
+    0xF129, 0xD675, 0x7605,
+    0xF229, 0xD675, 0x7605,
+    0x00EE,
+]
+
+
+def arith():
+    main = [0x6600, 0x6700]
+    # Result, then the VF it left behind, one operation per line
+    for vx, vy, n in [(200, 100, 4), (5, 10, 5), (0xF1, 0, 6), (0x81, 0, 0xE), (10, 5, 7)]:
+        main += [0x6500 | vx, 0x6300 | vy, 0x8530 | n, 0x84F0, (0x2000, "bcd"), 0x8540, (0x2000, "bcd"), 0x6600, 0x7706]
+    main += [0x6628, 0x6700]
+    for vx, vy, n in [(0xF0, 0x0F, 1), (0xFC, 0x3F, 2), (0xFF, 0x0F, 3)]:
+        main += [0x6500 | vx, 0x6300 | vy, 0x8530 | n, (0x2000, "bcd"), 0x6628, 0x7706]
+    main += ["halt", (0x1000, "halt")]
+
+    # The subroutine sits at 0x300
+    padding = 0x80 - sum(1 for item in main if not isinstance(item, str))
+    return main + [0x0000] * padding + ["bcd"] + DRAW_BCD
+
+
+write("arith.ch8", arith())
+
+# Waits for the delay timer, then draws a digit clipped by the bottom right screen edge
+write("timer.ch8", [
+    0x601E, 0xF015,
+    "wait",
+    0xF107, 0x3100, (0x1000, "wait"),
+    0x623C, 0x631D, 0xF129, 0xD235,
+    "halt",
+    (0x1000, "halt"),
+])
+
+# Draws each key pressed (Fx0A) and waits for its release (Ex9E)
+write("keys.ch8", [
+    0x6600, 0x6700,
+    "next",
+    0xF00A, 0xF029, 0xD675, 0x7605,
+    "held",
+    0xE09E, (0x1000, "next"), (0x1000, "held"),
+])
+
+# Draws the low digit of V5 at (V6, V7) and moves V6 past it
+DRAW_DIGIT = [0xF529, 0xD675, 0x7605, 0x00EE]
+
+# Skips: each case counts 1 in V5 unless the instruction skipped, then draws V5.
+# V1 = 1, V2 = 1, V3 = 2
+def skips():
+    program = [0x6600, 0x6700, 0x6101, 0x6201, 0x6302]
+    for opcode in [
+        0x3101, 0x3102,  # 3xkk equal, not equal
+        0x4101, 0x4102,  # 4xkk
+        0x5120, 0x5130,  # 5xy0
+        0x9120, 0x9130,  # 9xy0
+    ]:
+        program += [0x6500, opcode, 0x7501, (0x2000, "digit")]
+    program += ["halt", (0x1000, "halt"), "digit"] + DRAW_DIGIT
+    return program
+
+
+write("skips.ch8", skips())
+
+# Memory and jumps, one line each:
+#   Fx55 stores V0-V3, Fx1E moves I, Fx65 reads two of them back
+#   Bnnn jumps into a table of two-instruction entries at V0 = 4, landing on the second
+#   Cxkk with kk = FF, then kk = 0F
+write("memory.ch8", [
+    0x6600, 0x6700,
+    0x6001, 0x6102, 0x6203, 0x6304, 0xA500, 0xF355,
+    0xA500, 0x6402, 0xF41E, 0xF165,
+    0x8500, (0x2000, "digit"), 0x8510, (0x2000, "digit"),
+    0x6600, 0x7706,
+
+    0x6004, (0xB000, "table"),
+    "table",
+    0x6501, (0x1000, "jumped"),
+    0x6502, (0x1000, "jumped"),
+    0x6503, (0x1000, "jumped"),
+    "jumped",
+    (0x2000, "digit"),
+    0x6600, 0x7706,
+
+    0xC5FF, (0x2000, "bcd"), 0xC5FF, (0x2000, "bcd"),
+    0x6600, 0x7706,
+    0xC50F, (0x2000, "bcd"), 0xC50F, (0x2000, "bcd"),
+
+    "halt",
+    (0x1000, "halt"),
+    "digit",
+] + DRAW_DIGIT + ["bcd"] + DRAW_BCD)
+
+# Dxyn collisions and 00E0. First fills the top row with digits and waits on the delay
+# timer; then clears the screen and prints the VF left by:
+#   a first draw, the same sprite again (erasing it), an overlapping sprite,
+#   a sprite next to it, and a sprite overlapping only past the right edge (clipped)
+write("collision.ch8", [
+    0x6600, 0x6700,
+    0x6508, (0x2000, "digit"), (0x2000, "digit"), (0x2000, "digit"), (0x2000, "digit"),
+    0x6014, 0xF015,
+    "wait",
+    0xF007, 0x3000, (0x1000, "wait"),
+    0x00E0,
+
+    0x6A00, 0x6B14, 0x6008, 0xF029,
+    0xDAB5, 0x88F0,     # first draw
+    0xDAB5, 0x89F0,     # same place again
+    0xDAB5,
+    0x6001, 0xF029,
+    0xDAB5, 0x8CF0,     # 1 over 8
+    0x6A08,
+    0xDAB5, 0x8DF0,     # next to it
+    0x6A3C, 0x6B00,
+    0xDAB5,
+    0x6A3E,
+    0xDAB5, 0x8EF0,     # overlap inside the clipped sprite
+
+    0x6600, 0x670A,
+    0x8580, (0x2000, "digit"),
+    0x8590, (0x2000, "digit"),
+    0x85C0, (0x2000, "digit"),
+    0x85D0, (0x2000, "digit"),
+    0x85E0, (0x2000, "digit"),
+    "halt",
+    (0x1000, "halt"),
+    "digit",
+] + DRAW_DIGIT)
+
+# Waits for key 7 with ExA1, draws a 7, then waits for its release the same way
+write("keyup.ch8", [
+    0x6600, 0x6700, 0x6107,
+    "up",
+    0xE1A1, (0x1000, "pressed"), (0x1000, "up"),
+    "pressed",
+    0xF129, 0xD675, 0x7605,
+    "down",
+    0xE1A1, (0x1000, "down"), (0x1000, "up"),
+])
+
+# Fx18 starts the buzzer for 10 frames
+write("sound.ch8", [
+    0x650A, 0xF518,
+    "halt",
+    (0x1000, "halt"),
+])
+
+# Batch environment episode: stores two Cxkk bytes at 0x400 as the score, then sets the
+# done flag at 0x410
+write("episode.ch8", [
+    0xC0FF, 0xC1FF, 0xA400, 0xF155,
+    0x6001, 0xA410, 0xF055,
+    "halt",
+    (0x1000, "halt"),
+])